@@ -2,27 +2,455 @@
  * Baud
  *
  * Slows down text output to various baud rate speeds.
+ *
+ * The source is read in large blocks. Under DOS the characters are written
+ * straight into the text mode video buffer, with its own cursor, scrolling,
+ * and basic ANSI/VT100 escape sequence handling. When stdout is redirected,
+ * or when built for another host, they are written to a buffered file
+ * descriptor instead.
  */
 
-#include <conio.h>                      // clrscr getch kbhit
-#include <dos.h>                        // delay
-#include <stdio.h>                      // printf, getchar, putchar
-#include <stdlib.h>                     // atoi, EXIT_SUCCESS, EXIT_FAILURE
+#include <fcntl.h>                      // open O_RDONLY O_BINARY
+#include <stdio.h>                      // printf fflush
+#include <stdlib.h>                     // atoi EXIT_SUCCESS EXIT_FAILURE
+#include <string.h>                     // memcpy
+#ifdef __DOS__
+#include <conio.h>                      // getch kbhit
+#include <dos.h>                        // delay int86 intdos
+#include <io.h>                         // read write close setmode
+#else
+#include <unistd.h>                     // read write close usleep
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 
 #define ESC    0x1b
 #define CTRL_C 0x03
+#define CTRL_Z 0x1a                     // dos end of file marker
+
+#define STDIN 0                         // standard input file descriptor
+#define STDOUT 1                        // standard output file descriptor
+#define IN_BUFFER_SIZE 8192             // bytes read from the source at a time
+#define OUT_BUFFER_SIZE 8192            // bytes written to stdout at a time
+
+#define DOS_INT 0x21                    // DOS interrupt
+#define IOCTL_GET_INFO 0x4400           // DOS function to get device information
+#define DEVICE_BIT 0x80                 // 1 = handle is a character device
+#define CONSOLE_OUT_BIT 0x02            // 1 = device is the console output
+#define VIDEO_INT 0x10                  // BIOS video interrupt
+#define SET_CURSOR 0x02                 // BIOS function to set cursor position
+#define GET_CURSOR 0x03                 // BIOS function to get cursor position
+#define COLOR_TEXT_MEMORY 0xB8000000L   // start of color text video memory
+#define MONO_TEXT_MEMORY 0xB0000000L    // start of monochrome text video memory
+#define MONO_TEXT_MODE 0x07             // monochrome text video mode
+#define BIOS_VIDEO_MODE 0x00400049L     // BIOS data area: current video mode
+#define BIOS_COLUMNS 0x0040004AL        // BIOS data area: text columns
+#define BIOS_ROWS 0x00400084L           // BIOS data area: text rows minus one
+#define DEFAULT_ROWS 25                 // rows when the BIOS does not say
+#define DEFAULT_ATTR 0x07               // light gray on black
+#define TAB_SIZE 8                      // columns between tab stops
+#define ANSI_MAX_PARAMS 8               // parameters kept per escape sequence
+
+typedef unsigned char byte;
+typedef unsigned short ushort;
+
+// escape sequence parser states
+enum ANSI_STATES {
+    ANSI_NONE,                          // plain text
+    ANSI_ESC,                           // got ESC
+    ANSI_CSI                            // got ESC [
+};
+
+byte in_buffer[IN_BUFFER_SIZE];
+byte out_buffer[OUT_BUFFER_SIZE];
+ushort out_length;
+
+#ifdef __DOS__
+// ansi color order (black red green yellow blue magenta cyan white) to cga order
+static byte ansi_colors[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+ushort far *text;                       // text mode video memory
+#endif
+byte direct_video;                      // 1 = write to video memory, 0 = stdout
+byte text_columns, text_rows;
+byte cursor_x, cursor_y, saved_x, saved_y;
+byte text_fg, text_bg, text_bold, text_blink, text_reverse, text_attr;
+
+byte ansi_state;
+byte ansi_count;
+ushort ansi_params[ANSI_MAX_PARAMS];
 
 void usage(char app[]) {
     printf("Usage: %s BAUD [FILE]\n", app);
     printf("Where BAUD is any number, but often one of the standard bit rates:\n");
     printf("  50, 110, 300, 600, 1200, 2400, 4800, 9600\n");
+    printf("Use a BAUD of 0 to disable pacing.\n");
     printf("If FILE is given, then it is used as the source. Otherwise, STDIN is used.\n");
 }
 
+void wait_ms(int ms) {
+#ifdef __DOS__
+    delay(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+// return true if ESC or CTRL-C has been pressed, discarding any other keys
+int quit_pressed() {
+#ifdef __DOS__
+    char kc;
+
+    while (kbhit()) {
+        kc = getch();
+        if (kc == (char)0) {
+            getch();
+        } else if (kc == ESC || kc == CTRL_C) {
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+void fd_flush() {
+    ushort i;
+    int rc;
+
+    for (i = 0; i < out_length; i += rc) {
+        rc = write(STDOUT, out_buffer + i, out_length - i);
+        if (rc <= 0) break;
+    }
+    out_length = 0;
+}
+
+void fd_write(byte *buffer, ushort length) {
+    if (out_length + length > OUT_BUFFER_SIZE) fd_flush();
+    memcpy(out_buffer + out_length, buffer, length);
+    out_length += length;
+}
+
+#ifdef __DOS__
+// return true if stdout is the console and not redirected to a file or device
+int stdout_is_console() {
+    union REGS regs;
+
+    regs.w.ax = IOCTL_GET_INFO;
+    regs.w.bx = STDOUT;
+    intdos(&regs, &regs);
+    if (regs.w.cflag) return 0;
+    return (regs.w.dx & DEVICE_BIT) && (regs.w.dx & CONSOLE_OUT_BIT);
+}
+
+void text_sync_cursor() {
+    union REGS regs;
+
+    regs.h.ah = SET_CURSOR;
+    regs.h.bh = 0;
+    regs.h.dh = cursor_y;
+    regs.h.dl = cursor_x;
+    int86(VIDEO_INT, &regs, &regs);
+}
+
+void text_update_attr() {
+    byte fg, bg;
+
+    fg = text_fg;
+    bg = text_bg;
+    if (text_reverse) {
+        fg = text_bg;
+        bg = text_fg;
+    }
+    text_attr = (text_blink << 7) | (bg << 4) | (text_bold << 3) | fg;
+}
+
+void text_reset_attr() {
+    text_fg = DEFAULT_ATTR & 0x07;
+    text_bg = 0;
+    text_bold = 0;
+    text_blink = 0;
+    text_reverse = 0;
+    text_update_attr();
+}
+
+// fill cells from start up to (but not including) end with blanks
+void text_clear(ushort start, ushort end) {
+    ushort i, blank;
+
+    blank = (text_attr << 8) | ' ';
+    for (i = start; i < end; i++) {
+        text[i] = blank;
+    }
+}
+
+void text_scroll() {
+    ushort i, count;
+
+    count = (text_rows - 1) * text_columns;
+    for (i = 0; i < count; i++) {
+        text[i] = text[i + text_columns];
+    }
+    text_clear(count, count + text_columns);
+}
+
+void text_newline() {
+    cursor_x = 0;
+    if (cursor_y + 1 < text_rows) {
+        cursor_y++;
+    } else {
+        text_scroll();
+    }
+}
+
+void text_init() {
+    union REGS regs;
+
+    if (*(byte far *)BIOS_VIDEO_MODE == MONO_TEXT_MODE) {
+        text = (ushort far *)MONO_TEXT_MEMORY;
+    } else {
+        text = (ushort far *)COLOR_TEXT_MEMORY;
+    }
+    text_columns = *(byte far *)BIOS_COLUMNS;
+    text_rows = *(byte far *)BIOS_ROWS + 1;
+    if (text_rows == 1) text_rows = DEFAULT_ROWS;
+
+    regs.h.ah = GET_CURSOR;
+    regs.h.bh = 0;
+    int86(VIDEO_INT, &regs, &regs);
+    cursor_x = regs.h.dl;
+    cursor_y = regs.h.dh;
+    saved_x = cursor_x;
+    saved_y = cursor_y;
+
+    text_reset_attr();
+    ansi_state = ANSI_NONE;
+}
+
+// return escape sequence parameter i, or def if it is missing or zero
+ushort ansi_param(byte i, ushort def) {
+    if (i >= ansi_count || ansi_params[i] == 0) return def;
+    return ansi_params[i];
+}
+
+void ansi_sgr() {
+    byte i;
+    ushort p;
+
+    if (ansi_count == 0) ansi_count = 1;
+    for (i = 0; i < ansi_count; i++) {
+        p = ansi_params[i];
+        if (p == 0) {
+            text_reset_attr();
+        } else if (p == 1) {
+            text_bold = 1;
+        } else if (p == 5) {
+            text_blink = 1;
+        } else if (p == 7) {
+            text_reverse = 1;
+        } else if (p == 22) {
+            text_bold = 0;
+        } else if (p == 25) {
+            text_blink = 0;
+        } else if (p == 27) {
+            text_reverse = 0;
+        } else if (p >= 30 && p <= 37) {
+            text_fg = ansi_colors[p - 30];
+        } else if (p == 39) {
+            text_fg = DEFAULT_ATTR & 0x07;
+        } else if (p >= 40 && p <= 47) {
+            text_bg = ansi_colors[p - 40];
+        } else if (p == 49) {
+            text_bg = 0;
+        }
+    }
+    text_update_attr();
+}
+
+void ansi_command(byte command) {
+    ushort n, cursor, row;
+
+    cursor = cursor_y * text_columns + cursor_x;
+    row = cursor_y * text_columns;
+
+    switch (command) {
+    case 'A':
+        n = ansi_param(0, 1);
+        cursor_y = (n > cursor_y) ? 0 : cursor_y - n;
+        break;
+    case 'B':
+        n = ansi_param(0, 1);
+        cursor_y = (cursor_y + n >= text_rows) ? text_rows - 1 : cursor_y + n;
+        break;
+    case 'C':
+        n = ansi_param(0, 1);
+        cursor_x = (cursor_x + n >= text_columns) ? text_columns - 1 : cursor_x + n;
+        break;
+    case 'D':
+        n = ansi_param(0, 1);
+        cursor_x = (n > cursor_x) ? 0 : cursor_x - n;
+        break;
+    case 'H':
+    case 'f':
+        n = ansi_param(0, 1);
+        cursor_y = (n > text_rows) ? text_rows - 1 : n - 1;
+        n = ansi_param(1, 1);
+        cursor_x = (n > text_columns) ? text_columns - 1 : n - 1;
+        break;
+    case 'J':
+        n = ansi_param(0, 0);
+        if (n == 0) {
+            text_clear(cursor, text_rows * text_columns);
+        } else if (n == 1) {
+            text_clear(0, cursor + 1);
+        } else {
+            // like ANSI.SYS, clearing the whole screen also homes the cursor
+            text_clear(0, text_rows * text_columns);
+            cursor_x = 0;
+            cursor_y = 0;
+        }
+        break;
+    case 'K':
+        n = ansi_param(0, 0);
+        if (n == 0) {
+            text_clear(cursor, row + text_columns);
+        } else if (n == 1) {
+            text_clear(row, cursor + 1);
+        } else {
+            text_clear(row, row + text_columns);
+        }
+        break;
+    case 'm':
+        ansi_sgr();
+        break;
+    case 's':
+        saved_x = cursor_x;
+        saved_y = cursor_y;
+        break;
+    case 'u':
+        cursor_x = saved_x;
+        cursor_y = saved_y;
+        break;
+    }
+}
+
+// feed one byte that is part of an escape sequence to the parser
+void ansi_put(byte ch) {
+    if (ansi_state == ANSI_ESC) {
+        ansi_state = ANSI_NONE;
+        if (ch == '[') {
+            ansi_state = ANSI_CSI;
+            ansi_count = 0;
+            ansi_params[0] = 0;
+        } else if (ch == '7') {
+            saved_x = cursor_x;
+            saved_y = cursor_y;
+        } else if (ch == '8') {
+            cursor_x = saved_x;
+            cursor_y = saved_y;
+        }
+        return;
+    }
+
+    if (ch >= '0' && ch <= '9') {
+        if (ansi_count == 0) ansi_count = 1;
+        if (ansi_count <= ANSI_MAX_PARAMS) {
+            ansi_params[ansi_count - 1] = ansi_params[ansi_count - 1] * 10 + (ch - '0');
+        }
+    } else if (ch == ';') {
+        if (ansi_count == 0) ansi_count = 1;
+        if (ansi_count < ANSI_MAX_PARAMS) ansi_params[ansi_count] = 0;
+        ansi_count++;
+    } else if (ch == '?' || ch == '=') {
+        // private mode prefix, parameters are still collected and ignored
+    } else if (ch >= 0x40 && ch <= 0x7e) {
+        if (ansi_count > ANSI_MAX_PARAMS) ansi_count = ANSI_MAX_PARAMS;
+        ansi_state = ANSI_NONE;
+        ansi_command(ch);
+    } else {
+        // anything else aborts the sequence
+        ansi_state = ANSI_NONE;
+    }
+}
+
+void text_write(byte *buffer, ushort length) {
+    ushort i, cell;
+    byte ch;
+
+    cell = cursor_y * text_columns + cursor_x;
+
+    for (i = 0; i < length; i++) {
+        ch = buffer[i];
+
+        // fast path: printable characters go straight to video memory
+        if (ch >= ' ' && ansi_state == ANSI_NONE) {
+            text[cell++] = (text_attr << 8) | ch;
+            if (++cursor_x >= text_columns) {
+                text_newline();
+                cell = cursor_y * text_columns;
+            }
+            continue;
+        }
+
+        if (ansi_state != ANSI_NONE) {
+            ansi_put(ch);
+        } else {
+            switch (ch) {
+            case ESC:
+                ansi_state = ANSI_ESC;
+                break;
+            case '\r':
+                cursor_x = 0;
+                break;
+            case '\n':
+                text_newline();
+                break;
+            case '\b':
+                if (cursor_x > 0) cursor_x--;
+                break;
+            case '\t':
+                cursor_x = (cursor_x + TAB_SIZE) & ~(TAB_SIZE - 1);
+                if (cursor_x >= text_columns) text_newline();
+                break;
+            case '\a':
+            case CTRL_Z:
+                break;
+            default:
+                // other control characters have glyphs in code page 437
+                text[cell] = (text_attr << 8) | ch;
+                if (++cursor_x >= text_columns) text_newline();
+                break;
+            }
+        }
+        cell = cursor_y * text_columns + cursor_x;
+    }
+}
+#endif
+
+void output_write(byte *buffer, ushort length) {
+#ifdef __DOS__
+    if (direct_video) {
+        text_write(buffer, length);
+        return;
+    }
+#endif
+    fd_write(buffer, length);
+}
+
+void output_flush() {
+#ifdef __DOS__
+    if (direct_video) {
+        text_sync_cursor();
+        return;
+    }
+#endif
+    fd_flush();
+}
+
 int main(int argc, char *argv[]) {
-    int baud, baud_delay, rc;
-    char ch, kc;
-    FILE *file = NULL;
+    int baud, baud_delay, length, i;
+    int fd = STDIN;
 
     if (argc < 2 || argc > 3) {
         usage(argv[0]);
@@ -31,46 +459,59 @@ int main(int argc, char *argv[]) {
 
     baud = atoi(argv[1]);
 
-    if (baud < 1 || baud > 9600) {
+    if (baud < 0 || baud > 9600) {
         usage(argv[0]);
         return EXIT_FAILURE;
     }
 
     if (argc == 3) {
-        file = fopen(argv[2], "r");
-        if (file == NULL) {
+        fd = open(argv[2], O_RDONLY | O_BINARY);
+        if (fd < 0) {
             printf("Could not open file for reading: %s\n", argv[2]);
             return EXIT_FAILURE;
         }
     }
+#ifdef __DOS__
+    else {
+        setmode(STDIN, O_BINARY);
+    }
+#endif
 
-    baud_delay = 8 * 1000 / baud;
+    baud_delay = (baud > 0) ? 8 * 1000 / baud : 0;
     printf("-- baud_delay: %d\n", baud_delay);
-    kc = 0;
-
-    // loop until ESC or CTRL-C is pressed
-    while (kc != ESC && kc != CTRL_C) {
-        while (!kbhit()) {
-            if (file == NULL) {
-                ch = getchar();
-                if (ch == EOF) return EXIT_SUCCESS;
-            } else {
-                ch = fgetc(file);
-                if (feof(file)) {
-                    fclose(file);
-                    return EXIT_SUCCESS;
-                }
+    fflush(stdout);
+
+#ifdef __DOS__
+    direct_video = stdout_is_console();
+    if (direct_video) {
+        text_init();
+    } else {
+        setmode(STDOUT, O_BINARY);
+    }
+#endif
+
+    // loop until the source is exhausted or ESC or CTRL-C is pressed
+    while ((length = read(fd, in_buffer, IN_BUFFER_SIZE)) > 0) {
+        if (baud_delay > 0) {
+            for (i = 0; i < length; i++) {
+                if (quit_pressed()) goto done;
+                wait_ms(baud_delay);
+                output_write(in_buffer + i, 1);
+                output_flush();
             }
-            if (baud_delay > 0) delay(baud_delay);
-            putchar(ch);
-            fflush(stdout);
+        } else {
+            // unpaced, so only check the keyboard and sync the cursor once
+            // per block
+            if (quit_pressed()) break;
+            output_write(in_buffer, length);
+            output_flush();
         }
-
-        kc = getch();
-        if (kc == (char)0) kc = getch();
     }
 
-    if (file != NULL) fclose(file);
+done:
+    output_flush();
+
+    if (fd != STDIN) close(fd);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,126 @@
+/**
+ * Keyboard
+ *
+ * Interrupt driven keyboard input for the graphics programs.
+ */
+
+#include <stdlib.h>                     // atexit
+#include "vga.h"                        // inp outp kbhit getch
+#include "keyboard.h"
+
+#define KEYBOARD_INT 0x09               // keyboard hardware interrupt (IRQ 1)
+#define KB_DATA 0x60                    // keyboard controller data port
+#define KB_EXTENDED 0xE0                // prefix of extended scancodes
+#define KB_PAUSE 0xE1                   // prefix of the pause key sequence
+#define KB_CONTROL 0x61                 // ppi port b, bit 7 acknowledges on an XT
+#define KB_ACK 0x80
+#define PIC_COMMAND 0x20                // master pic command register
+#define PIC_EOI 0x20                    // command: end of interrupt
+
+volatile byte kb_buffer[KB_BUFFER_SIZE];
+volatile byte kb_head;
+volatile byte kb_tail;
+volatile byte kb_held[16];
+static byte kb_extended;                // 1 = the last scancode was E0
+
+#ifdef __DOS__
+static void (__interrupt __far *bios_handler)(void);
+
+// the stack is whatever the interrupted code was using, so do not check it
+#pragma off (check_stack)
+#endif
+
+// note a press or release; presses go into the ring unless it is full or
+// the key is a modifier or lock key, which only show up in kb_held
+void kb_scancode(byte scancode) {
+    byte key, next, extended;
+
+    extended = kb_extended;
+    kb_extended = (scancode == KB_EXTENDED);
+    if (scancode == KB_EXTENDED || scancode == KB_PAUSE) return;
+    key = scancode & ~KB_RELEASE;
+    // the shift codes a gray key is wrapped in for NumLock or Shift
+    if (extended && (key == KEY_LEFT_SHIFT || key == KEY_RIGHT_SHIFT)) return;
+    if (scancode & KB_RELEASE) {
+        kb_held[key >> 3] &= ~(1 << (key & 7));
+        return;
+    }
+    kb_held[key >> 3] |= 1 << (key & 7);
+
+    // Shift for + or Alt-Tab out of a window must not read as a key press;
+    // this also drops the Ctrl and NumLock codes of the Pause sequence
+    switch (key) {
+    case KEY_CTRL:
+    case KEY_LEFT_SHIFT:
+    case KEY_RIGHT_SHIFT:
+    case KEY_ALT:
+    case KEY_CAPS_LOCK:
+    case KEY_NUM_LOCK:
+    case KEY_SCROLL_LOCK:
+        return;
+    }
+
+    next = (kb_head + 1) & (KB_BUFFER_SIZE - 1);
+    if (next == kb_tail) return;
+    kb_buffer[kb_head] = scancode;
+    kb_head = next;
+}
+
+#ifdef __DOS__
+void __interrupt __far kb_handler(void) {
+    byte control;
+
+    kb_scancode(inp(KB_DATA));
+
+    // pulse bit 7 so an XT keyboard sends the next scancode; harmless on AT
+    control = inp(KB_CONTROL);
+    outp(KB_CONTROL, control | KB_ACK);
+    outp(KB_CONTROL, control);
+
+    outp(PIC_COMMAND, PIC_EOI);
+}
+
+#pragma on (check_stack)
+#endif
+
+// install the handler; kb_done() is run at exit
+void kb_init(void) {
+#ifdef __DOS__
+    if (bios_handler != NULL) return;
+    bios_handler = _dos_getvect(KEYBOARD_INT);
+    _dos_setvect(KEYBOARD_INT, kb_handler);
+    atexit(kb_done);
+#endif
+}
+
+// put the BIOS handler back
+void kb_done(void) {
+#ifdef __DOS__
+    if (bios_handler == NULL) return;
+    _dos_setvect(KEYBOARD_INT, bios_handler);
+    bios_handler = NULL;
+#endif
+}
+
+#ifndef __DOS__
+int kb_hit(void) {
+    if (kb_head == kb_tail && kbhit()) kb_scancode(getch());
+    return kb_head != kb_tail;
+}
+#endif
+
+// next key press from the ring buffer, 0 if there is none
+byte kb_read(void) {
+    byte scancode;
+
+    if (!kb_hit()) return 0;
+    scancode = kb_buffer[kb_tail];
+    kb_tail = (kb_tail + 1) & (KB_BUFFER_SIZE - 1);
+    return scancode;
+}
+
+// wait for a key press and return it
+byte kb_wait(void) {
+    while (!kb_hit());
+    return kb_read();
+}
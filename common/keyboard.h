@@ -0,0 +1,75 @@
+/**
+ * Keyboard
+ *
+ * Interrupt driven keyboard input for the graphics programs.
+ *
+ * kb_init() replaces the BIOS INT 9 handler with one that reads each
+ * scancode from the keyboard controller. Key presses go into a ring buffer
+ * and every press and release updates a bitmap of the keys held down.
+ * Modifier and lock keys (Shift, Ctrl, Alt, CapsLock, NumLock, ScrollLock)
+ * only update the bitmap, so they never end a program waiting for a key. The
+ * handler is the only writer of kb_head and the program the only writer of
+ * kb_tail, so neither side needs to turn interrupts off, and checking for a
+ * key with kb_hit() or KB_HELD() is a memory read instead of a BIOS call.
+ *
+ * While the handler is installed the BIOS sees no keys: kbhit(), getch()
+ * and Ctrl-Break stop working until kb_done() (run at exit) puts it back.
+ * Extended keys (E0 prefix) report the scancode of their keypad twin, and
+ * the fake Shift codes the keyboard wraps gray keys in are dropped.
+ *
+ * Built for any other host (see test/) there is no interrupt; kb_hit()
+ * feeds the ring from the host's kbhit() and getch().
+ */
+
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include "vga.h"                        // byte
+
+#define KB_BUFFER_SIZE 32               // ring buffer size, a power of two
+#define KB_RELEASE 0x80                 // scancode bit: key released
+
+// scancodes
+#define KEY_ESC 0x01
+#define KEY_MINUS 0x0C
+#define KEY_EQUALS 0x0D                 // the unshifted + key
+#define KEY_ENTER 0x1C
+#define KEY_CTRL 0x1D                   // modifier and lock keys are only held
+#define KEY_LEFT_SHIFT 0x2A
+#define KEY_RIGHT_SHIFT 0x36
+#define KEY_ALT 0x38
+#define KEY_SPACE 0x39
+#define KEY_CAPS_LOCK 0x3A
+#define KEY_NUM_LOCK 0x45
+#define KEY_SCROLL_LOCK 0x46
+#define KEY_UP 0x48
+#define KEY_PAGE_UP 0x49
+#define KEY_PAD_MINUS 0x4A
+#define KEY_LEFT 0x4B
+#define KEY_RIGHT 0x4D
+#define KEY_PAD_PLUS 0x4E
+#define KEY_DOWN 0x50
+#define KEY_PAGE_DOWN 0x51
+
+extern volatile byte kb_buffer[KB_BUFFER_SIZE];
+extern volatile byte kb_head;           // next slot the handler fills
+extern volatile byte kb_tail;           // next slot the program reads
+extern volatile byte kb_held[16];       // one bit per scancode
+
+// true while the key with this scancode is held down
+#define KB_HELD(scancode) (kb_held[(scancode) >> 3] & (1 << ((scancode) & 7)))
+
+void kb_init(void);
+void kb_done(void);
+void kb_scancode(byte scancode);
+byte kb_read(void);
+byte kb_wait(void);
+
+#ifdef __DOS__
+// true if a key press is waiting in the ring buffer
+#define kb_hit() (kb_head != kb_tail)
+#else
+int kb_hit(void);
+#endif
+
+#endif
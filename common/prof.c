@@ -0,0 +1,311 @@
+/**
+ * Profiling
+ *
+ * Section timers and hot path counters for the graphics programs.
+ */
+
+#include <stdio.h>                      // fopen fprintf sprintf
+#include <stdlib.h>                     // atexit getenv
+#include "vga.h"                        // INT86 screen_width
+#include "prof.h"
+#ifndef __DOS__
+#include <time.h>                       // clock_gettime
+#endif
+
+#define PIT_CONTROL 0x43                // pit mode/command register
+#define PIT_COUNTER_0 0x40              // pit counter 0 data port
+#define PIT_LATCH_0 0x00                // command: latch counter 0
+#define PIT_MODE_2 0x34                 // command: counter 0, lo/hi, rate generator
+#define PIT_MODE_3 0x36                 // command: counter 0, lo/hi, square wave (bios)
+#define PIT_TICKS_PER_MS 1193.182       // pit input clock
+#define PIC_COMMAND 0x20                // master pic command register
+#define PIC_READ_IRR 0x0A               // command: read interrupt request register
+#define BIOS_TICK_MS 54.9254            // milliseconds per bios timer tick
+#define CALIBRATE_TICKS 4               // bios ticks used to calibrate rdtsc
+#define EFLAGS_ID 0x00200000L           // eflags bit that can be toggled if cpuid exists
+#define CPUID_TSC 0x0010                // cpuid 1 edx bit: time stamp counter
+#define SET_CURSOR 0x02                 // BIOS function to set cursor position
+#define TELETYPE 0x0E                   // BIOS function to write a character
+#define OVERLAY_COLOR 15                // overlay text color
+#define DEFAULT_FILE "PROFILE.TXT"      // dump file unless PROFILE is set
+
+#ifdef __386__
+#define BIOS_TICKS ((volatile ulong *)0x46CL)
+#else
+#define BIOS_TICKS ((volatile ulong far *)0x0040006CL)
+#endif
+
+#if defined(__DOS__) && defined(__386__)
+ulong read_eflags(void);
+#pragma aux read_eflags = "pushfd" "pop eax" value [eax];
+
+void write_eflags(ulong eflags);
+#pragma aux write_eflags = "push eax" "popfd" parm [eax];
+
+ulong cpuid_features(void);
+#pragma aux cpuid_features = \
+    "mov eax, 1" \
+    0x0f 0xa2                           /* cpuid */ \
+    value [edx] modify [eax ebx ecx edx];
+
+ulong read_tsc(void);
+#pragma aux read_tsc = \
+    0x0f 0x31                           /* rdtsc */ \
+    value [eax] modify [edx];
+#elif defined(__DOS__)
+ushort read_flags(void);
+#pragma aux read_flags = "pushf" "pop ax" value [ax];
+
+void write_flags(ushort flags);
+#pragma aux write_flags = "push ax" "popf" parm [ax];
+
+// 32-bit instructions are emitted as bytes since this is 16-bit code
+ulong read_eflags(void);
+#pragma aux read_eflags = \
+    0x66 0x9c                           /* pushfd */ \
+    "pop ax" "pop dx" \
+    value [dx ax];
+
+void write_eflags(ulong eflags);
+#pragma aux write_eflags = \
+    "push dx" "push ax" \
+    0x66 0x9d                           /* popfd */ \
+    parm [dx ax];
+
+ushort cpuid_features(void);
+#pragma aux cpuid_features = \
+    0x66 0xb8 0x01 0x00 0x00 0x00       /* mov eax, 1 */ \
+    0x0f 0xa2                           /* cpuid */ \
+    value [dx] modify [ax bx cx dx];
+
+// low 32 bits of the time stamp counter in dx:ax
+ulong read_tsc(void);
+#pragma aux read_tsc = \
+    0x0f 0x31                           /* rdtsc */ \
+    0x66 0x89 0xc2                      /* mov edx, eax */ \
+    0x66 0xc1 0xea 0x10                 /* shr edx, 16 */ \
+    value [dx ax];
+#endif
+
+typedef struct {
+    ulong calls;
+    ulong start;
+    ulong total_lo;
+    ulong total_hi;
+    ulong max;
+} prof_section_s;
+
+static char *section_names[PROF_NUM_SECTIONS] = {
+    "compute_mandelbrot",
+    "draw_line",
+    "draw_box",
+    "set_palette",
+    "wait_for_retrace"
+};
+
+static char *counter_names[PROF_NUM_COUNTERS] = {
+    "pixels",
+    "port i/o"
+};
+
+ulong prof_counters[PROF_NUM_COUNTERS];
+prof_section_s prof_sections[PROF_NUM_SECTIONS];
+byte prof_tsc;                          // 1 = rdtsc, 0 = pit
+double prof_ticks_per_ms;
+
+#ifdef __DOS__
+// return true if the cpu is a 586 or better with a time stamp counter
+int has_tsc(void) {
+    ulong eflags;
+#ifndef __386__
+    ushort flags;
+
+    // an 8086 always sets flags bits 12-15, a 286 in real mode clears them
+    flags = read_flags();
+    write_flags(flags & 0x0FFF);
+    if ((read_flags() & 0xF000) == 0xF000) return 0;
+    write_flags(flags | 0x7000);
+    if ((read_flags() & 0x7000) == 0) {
+        write_flags(flags);
+        return 0;
+    }
+    write_flags(flags);
+#endif
+
+    // a 386 or early 486 can not toggle the id bit and has no cpuid
+    eflags = read_eflags();
+    write_eflags(eflags ^ EFLAGS_ID);
+    if (((read_eflags() ^ eflags) & EFLAGS_ID) == 0) return 0;
+    write_eflags(eflags);
+
+    return (cpuid_features() & CPUID_TSC) != 0;
+}
+#endif
+
+// return the current time in ticks; only differences are meaningful
+ulong prof_ticks(void) {
+#ifdef __DOS__
+    ulong bios;
+    ushort count, elapsed;
+
+    if (prof_tsc) return read_tsc();
+
+    // extend the 16-bit pit count with the bios tick count
+    _disable();
+    outp(PIT_CONTROL, PIT_LATCH_0);
+    count = inp(PIT_COUNTER_0);
+    count |= inp(PIT_COUNTER_0) << 8;
+    bios = *BIOS_TICKS;
+    outp(PIC_COMMAND, PIC_READ_IRR);
+    elapsed = 0 - count;
+    // the counter wrapped but the timer interrupt has not run yet
+    if ((inp(PIC_COMMAND) & 0x01) && elapsed < 0x8000) bios++;
+    _enable();
+
+    return (bios << 16) + elapsed;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ulong)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+void prof_begin(int section) {
+    prof_sections[section].start = prof_ticks();
+}
+
+void prof_end(int section) {
+    prof_section_s *s = &prof_sections[section];
+    ulong elapsed;
+
+    elapsed = prof_ticks() - s->start;
+    s->calls++;
+    s->total_lo += elapsed;
+    if (s->total_lo < elapsed) s->total_hi++;
+    if (elapsed > s->max) s->max = elapsed;
+}
+
+double prof_total_ms(prof_section_s *s) {
+    return (s->total_hi * 4294967296.0 + s->total_lo) / prof_ticks_per_ms;
+}
+
+#ifdef __DOS__
+void overlay_print(byte row, char *text) {
+    union REGS regs;
+
+    regs.h.ah = SET_CURSOR;
+    regs.h.bh = 0;
+    regs.h.dh = row;
+    regs.h.dl = 0;
+    INT86(VIDEO_INT, &regs, &regs);
+
+    for (; *text; text++) {
+        regs.h.ah = TELETYPE;
+        regs.h.al = *text;
+        regs.h.bh = 0;
+        regs.h.bl = OVERLAY_COLOR;
+        INT86(VIDEO_INT, &regs, &regs);
+    }
+}
+#endif
+
+// draw the results over the top left of the screen using the BIOS font
+void prof_overlay(void) {
+#ifdef __DOS__
+    char line[48];
+    uint columns;
+    byte i, row;
+
+    columns = screen_width / 8;
+    if (columns > sizeof(line)) columns = sizeof(line);
+    row = 0;
+
+    for (i = 0; i < PROF_NUM_SECTIONS; i++) {
+        if (prof_sections[i].calls == 0) continue;
+        sprintf(line, "%-12.12s %7lu %8.1fms",
+            section_names[i], prof_sections[i].calls, prof_total_ms(&prof_sections[i]));
+        line[columns - 1] = 0;
+        overlay_print(row++, line);
+    }
+    for (i = 0; i < PROF_NUM_COUNTERS; i++) {
+        sprintf(line, "%-12.12s %17lu", counter_names[i], prof_counters[i]);
+        line[columns - 1] = 0;
+        overlay_print(row++, line);
+    }
+#endif
+}
+
+void prof_dump(FILE *file) {
+    prof_section_s *s;
+    byte i;
+
+    fprintf(file, "%-20s %10s %12s %10s %10s\n", "section", "calls", "total ms", "avg us", "max us");
+    for (i = 0; i < PROF_NUM_SECTIONS; i++) {
+        s = &prof_sections[i];
+        if (s->calls == 0) continue;
+        fprintf(file, "%-20s %10lu %12.2f %10.2f %10.2f\n",
+            section_names[i], s->calls, prof_total_ms(s),
+            prof_total_ms(s) * 1000.0 / s->calls, s->max * 1000.0 / prof_ticks_per_ms);
+    }
+
+    fprintf(file, "\n%-20s %10s\n", "counter", "count");
+    for (i = 0; i < PROF_NUM_COUNTERS; i++) {
+        fprintf(file, "%-20s %10lu\n", counter_names[i], prof_counters[i]);
+    }
+
+    fprintf(file, "\ntimer: %s, %.1f ticks/ms\n",
+#ifdef __DOS__
+        prof_tsc ? "rdtsc" : "pit",
+#else
+        "clock_gettime",
+#endif
+        prof_ticks_per_ms);
+}
+
+void prof_exit(void) {
+    FILE *file;
+    char *name;
+
+#ifdef __DOS__
+    // put the pit back the way the bios left it
+    outp(PIT_CONTROL, PIT_MODE_3);
+    outp(PIT_COUNTER_0, 0);
+    outp(PIT_COUNTER_0, 0);
+#endif
+
+    name = getenv("PROFILE");
+    if (name == NULL || *name == 0) name = DEFAULT_FILE;
+    file = fopen(name, "w");
+    if (file == NULL) return;
+    prof_dump(file);
+    fclose(file);
+}
+
+void prof_init(void) {
+#ifdef __DOS__
+    ulong bios, start;
+
+    // mode 2 counts down by one per pit clock (mode 3 counts by two), same rate
+    outp(PIT_CONTROL, PIT_MODE_2);
+    outp(PIT_COUNTER_0, 0);
+    outp(PIT_COUNTER_0, 0);
+
+    prof_tsc = has_tsc();
+    if (prof_tsc) {
+        // count time stamp counter cycles over a few bios ticks
+        bios = *BIOS_TICKS;
+        while (*BIOS_TICKS == bios);
+        start = read_tsc();
+        bios = *BIOS_TICKS;
+        while (*BIOS_TICKS - bios < CALIBRATE_TICKS);
+        prof_ticks_per_ms = (read_tsc() - start) / (CALIBRATE_TICKS * BIOS_TICK_MS);
+    } else {
+        prof_ticks_per_ms = PIT_TICKS_PER_MS;
+    }
+#else
+    prof_ticks_per_ms = 1000000.0;
+#endif
+
+    atexit(prof_exit);
+}
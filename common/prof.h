@@ -0,0 +1,60 @@
+/**
+ * Profiling
+ *
+ * Section timers and hot path counters for the graphics programs.
+ *
+ * Time is read with RDTSC on a 586 or better and from a latched PIT counter
+ * 0 on anything older. Results are drawn over the picture with
+ * PROF_OVERLAY() and written to PROFILE.TXT (or the file named by the
+ * PROFILE environment variable) when the program exits.
+ *
+ * Everything is compiled out unless PROFILE is defined (make PROFILE=1), so
+ * release builds pay nothing for the macros left in the code.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+// timed sections
+enum PROF_SECTIONS {
+    PROF_COMPUTE_MANDELBROT,
+    PROF_DRAW_LINE,
+    PROF_DRAW_BOX,
+    PROF_SET_PALETTE,
+    PROF_RETRACE,
+    PROF_NUM_SECTIONS
+};
+
+// event counters
+enum PROF_COUNTERS {
+    PROF_PIXELS,                        // pixels written to video memory
+    PROF_PORT_IO,                       // inp/outp/outpw calls
+    PROF_NUM_COUNTERS
+};
+
+#ifdef PROFILE
+
+extern unsigned long prof_counters[PROF_NUM_COUNTERS];
+
+void prof_init(void);
+void prof_begin(int section);
+void prof_end(int section);
+void prof_overlay(void);
+
+#define PROF_INIT() prof_init()
+#define PROF_BEGIN(section) prof_begin(section)
+#define PROF_END(section) prof_end(section)
+#define PROF_COUNT(counter, n) (prof_counters[counter] += (n))
+#define PROF_OVERLAY() prof_overlay()
+
+#else
+
+#define PROF_INIT() ((void)0)
+#define PROF_BEGIN(section) ((void)0)
+#define PROF_END(section) ((void)0)
+#define PROF_COUNT(counter, n) ((void)0)
+#define PROF_OVERLAY() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,318 @@
+/**
+ * Record
+ *
+ * Capture what a graphics program draws as an FLC animation.
+ */
+
+#include <stdio.h>                      // fopen fwrite fseek ftell
+#include <stdlib.h>                     // getenv malloc free
+#include <string.h>                     // memcpy memset memcmp _fmemset
+#include "vga.h"                        // draw_pixel screen_width screen_height
+#include "record.h"
+
+#if defined(__DOS__) && !defined(__386__)
+#include <malloc.h>                     // _fmalloc _ffree
+#define RFAR far                        // rows are kept in the far heap
+#define row_alloc _fmalloc
+#define row_free _ffree
+#define row_memset _fmemset
+#else
+#define RFAR
+#define row_alloc malloc
+#define row_free free
+#define row_memset memset
+#endif
+
+#define MIN_RUN 3                       // shorter runs are stored as literals
+#define MAX_SKIP 255                    // longest skip in a line packet
+#define MAX_LINE_PACKETS 255            // packets in an FLC_LC line
+#define LINE_BUFFER_SIZE (VBE_MAX_SCREEN_WIDTH * 2) // worst case: 1 literal, 3 run, 6 bytes
+
+static FILE *record_file;
+static flc_header_s header;
+static void (*screen_pixel)(uint x, uint y, byte color);  // draw_pixel before recording
+static byte RFAR *rows[VBE_MAX_SCREEN_HEIGHT];            // copy of the screen
+static ushort dirty_first[VBE_MAX_SCREEN_HEIGHT];         // changed span of each row
+static ushort dirty_end[VBE_MAX_SCREEN_HEIGHT];
+static uint dirty_top, dirty_bottom;                      // changed rows
+static byte palette[VGA_256_COLOR_NUM_COLORS * 3];        // as set by the program
+static byte written_palette[VGA_256_COLOR_NUM_COLORS * 3];// as written to the file
+static byte palette_changed;
+static byte line[LINE_BUFFER_SIZE];                       // one encoded row
+static uint line_size, line_packets;
+
+// draw_pixel while recording: note changed pixels, then draw as usual
+void record_pixel(uint x, uint y, byte color) {
+    byte RFAR *pixel = rows[y] + x;
+
+    if (*pixel != color) {
+        *pixel = color;
+        if (x < dirty_first[y]) dirty_first[y] = x;
+        if (x >= dirty_end[y]) dirty_end[y] = x + 1;
+        if (y < dirty_top) dirty_top = y;
+        if (y >= dirty_bottom) dirty_bottom = y + 1;
+    }
+    screen_pixel(x, y, color);
+}
+
+void clear_dirty(void) {
+    uint y;
+
+    for (y = dirty_top; y < dirty_bottom; y++) {
+        dirty_first[y] = screen_width;
+        dirty_end[y] = 0;
+    }
+    dirty_top = screen_height;
+    dirty_bottom = 0;
+}
+
+// add a packet to line; for FLC_BYTE_RUN a run has a positive size and a
+// literal a negative one, for FLC_LC the other way around
+void put_packet(byte RFAR *pixels, uint count, byte run, byte lc) {
+    signed char size = (run != lc) ? (signed char)count : -(signed char)count;
+
+    line[line_size++] = (byte)size;
+    if (run) {
+        line[line_size++] = *pixels;
+    } else {
+        while (count--) line[line_size++] = *pixels++;
+    }
+    line_packets++;
+}
+
+// run length encode pixels first to end - 1 of row y into line; FLC_LC
+// packets start with a skip count, the first one skipping to first
+void encode_row(uint y, uint first, uint end, byte lc, uint min_run) {
+    byte RFAR *row = rows[y];
+    uint x, literal, run, count;
+
+    line_size = 0;
+    line_packets = 0;
+    if (lc) {
+        while (first > MAX_SKIP) {
+            // skip without drawing: a zero length literal
+            line[line_size++] = MAX_SKIP;
+            line[line_size++] = 0;
+            line_packets++;
+            first -= MAX_SKIP;
+            row += MAX_SKIP;
+            end -= MAX_SKIP;
+        }
+    }
+
+    literal = first;
+    for (x = first; x < end; x += run) {
+        for (run = 1; x + run < end && run < FLC_MAX_PACKET && row[x + run] == row[x]; run++);
+        if (run < min_run) continue;
+        for (; literal < x; literal += count) {
+            count = (x - literal > FLC_MAX_PACKET) ? FLC_MAX_PACKET : x - literal;
+            if (lc) line[line_size++] = (literal == first) ? first : 0;
+            put_packet(row + literal, count, 0, lc);
+        }
+        if (lc) line[line_size++] = (x == first) ? first : 0;
+        put_packet(row + x, run, 1, lc);
+        literal = x + run;
+    }
+    for (; literal < end; literal += count) {
+        count = (end - literal > FLC_MAX_PACKET) ? FLC_MAX_PACKET : end - literal;
+        if (lc) line[line_size++] = (literal == first) ? first : 0;
+        put_packet(row + literal, count, 0, lc);
+    }
+}
+
+// FLC_BYTE_RUN chunk of the whole screen; returns its size
+ulong write_byte_run(void) {
+    flc_chunk_s chunk;
+    uint y;
+
+    chunk.type = FLC_BYTE_RUN;
+    chunk.size = sizeof(chunk);
+    fwrite(&chunk, sizeof(chunk), 1, record_file);
+    for (y = 0; y < screen_height; y++) {
+        encode_row(y, 0, screen_width, 0, MIN_RUN);
+        // the packet count is ignored by players and can overflow
+        fputc(line_packets > MAX_LINE_PACKETS ? 0 : line_packets, record_file);
+        fwrite(line, line_size, 1, record_file);
+        chunk.size += 1 + line_size;
+    }
+    return chunk.size;
+}
+
+// FLC_LC chunk of the changed rows; returns its size
+ulong write_lc(void) {
+    flc_chunk_s chunk;
+    ushort lines[2];
+    uint y;
+
+    chunk.type = FLC_LC;
+    chunk.size = sizeof(chunk) + sizeof(lines);
+    lines[0] = dirty_top;
+    lines[1] = dirty_bottom - dirty_top;
+    fwrite(&chunk, sizeof(chunk), 1, record_file);
+    fwrite(lines, sizeof(lines), 1, record_file);
+    for (y = dirty_top; y < dirty_bottom; y++) {
+        if (dirty_first[y] >= dirty_end[y]) {
+            fputc(0, record_file);
+            chunk.size++;
+            continue;
+        }
+        encode_row(y, dirty_first[y], dirty_end[y], 1, MIN_RUN);
+        if (line_packets > MAX_LINE_PACKETS) {
+            // too many short runs, store the span as literals
+            encode_row(y, dirty_first[y], dirty_end[y], 1, FLC_MAX_PACKET + 1);
+        }
+        fputc(line_packets, record_file);
+        fwrite(line, line_size, 1, record_file);
+        chunk.size += 1 + line_size;
+    }
+    return chunk.size;
+}
+
+// FLC_COLOR_256 chunk of the palette entries that changed; returns its size
+ulong write_palette(void) {
+    flc_chunk_s chunk;
+    byte packet[4];
+    uint first, end, i;
+
+    first = 0;
+    end = VGA_256_COLOR_NUM_COLORS;
+    if (header.frames > 0) {
+        while (first < end && memcmp(palette + first * 3, written_palette + first * 3, 3) == 0) first++;
+        while (end > first && memcmp(palette + end * 3 - 3, written_palette + end * 3 - 3, 3) == 0) end--;
+        if (first == end) return 0;
+    }
+
+    chunk.type = FLC_COLOR_256;
+    chunk.size = sizeof(chunk) + sizeof(packet) + (end - first) * 3;
+    packet[0] = 1;                      // one packet
+    packet[1] = 0;
+    packet[2] = first;                  // entries skipped
+    packet[3] = end - first;            // entries set, 0 means 256
+    fwrite(&chunk, sizeof(chunk), 1, record_file);
+    fwrite(packet, sizeof(packet), 1, record_file);
+    for (i = first * 3; i < end * 3; i++) {
+        // 6 bit DAC values to 8 bits
+        fputc((palette[i] << 2) | (palette[i] >> 4), record_file);
+    }
+    memcpy(written_palette + first * 3, palette + first * 3, (end - first) * 3);
+    return chunk.size;
+}
+
+// end the current frame, writing whatever changed since the last one
+void record_frame(void) {
+    flc_frame_s frame;
+    long start;
+    ulong size;
+
+    if (record_file == NULL || header.frames == 0xFFFF) return;
+    if (header.frames == 1) header.frame2 = ftell(record_file);
+
+    memset(&frame, 0, sizeof(frame));
+    frame.type = FLC_FRAME;
+    frame.size = sizeof(frame);
+    if (header.frames > 0 && dirty_top >= dirty_bottom && !palette_changed) {
+        // nothing drawn, an empty frame keeps the timing
+        fwrite(&frame, sizeof(frame), 1, record_file);
+        header.frames++;
+        return;
+    }
+
+    start = ftell(record_file);
+    fwrite(&frame, sizeof(frame), 1, record_file);
+    if (palette_changed) {
+        size = write_palette();
+        frame.size += size;
+        if (size > 0) frame.chunks++;
+        palette_changed = 0;
+    }
+    if (header.frames == 0) {
+        frame.size += write_byte_run();
+        frame.chunks++;
+    } else if (dirty_top < dirty_bottom) {
+        frame.size += write_lc();
+        frame.chunks++;
+    }
+    clear_dirty();
+
+    // go back and fill in the frame size
+    fseek(record_file, start, SEEK_SET);
+    fwrite(&frame, sizeof(frame), 1, record_file);
+    fseek(record_file, 0, SEEK_END);
+    header.frames++;
+}
+
+// the program set count palette entries from index 0
+void record_palette(byte *rgb, uint count) {
+    memcpy(palette, rgb, count * 3);
+    palette_changed = 1;
+}
+
+void record_free(void) {
+    uint y;
+
+    for (y = 0; y < VBE_MAX_SCREEN_HEIGHT; y++) {
+        if (rows[y] != NULL) row_free(rows[y]);
+        rows[y] = NULL;
+    }
+}
+
+// start recording the screen as it is now (just after a mode set, it is
+// black); returns 0 if the file can not be written or there is no memory
+int record_open(char *name) {
+    char *env;
+    uint y;
+
+    if (record_file != NULL) return 0;
+    for (y = 0; y < screen_height; y++) {
+        rows[y] = row_alloc(screen_width);
+        if (rows[y] == NULL) {
+            record_free();
+            return 0;
+        }
+        row_memset(rows[y], 0, screen_width);
+    }
+
+    env = getenv("RECORD");
+    if (env != NULL && *env != 0) name = env;
+    record_file = fopen(name, "wb");
+    if (record_file == NULL) {
+        record_free();
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic = FLC_MAGIC;
+    header.width = screen_width;
+    header.height = screen_height;
+    header.depth = 8;
+    header.speed = FLC_FRAME_MS;
+    header.aspect_x = 1;
+    header.aspect_y = 1;
+    header.frame1 = sizeof(header);
+    fwrite(&header, sizeof(header), 1, record_file);
+
+    dirty_top = 0;
+    dirty_bottom = screen_height;
+    clear_dirty();
+    vga_default_palette(palette);
+    palette_changed = 1;
+
+    screen_pixel = draw_pixel;
+    draw_pixel = record_pixel;
+    return 1;
+}
+
+// write the last frame and the finished header
+void record_close(void) {
+    if (record_file == NULL) return;
+    if (dirty_top < dirty_bottom || palette_changed || header.frames == 0) record_frame();
+
+    if (draw_pixel == record_pixel) draw_pixel = screen_pixel;
+    header.flags = 3;
+    header.size = ftell(record_file);
+    fseek(record_file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, record_file);
+    fclose(record_file);
+    record_file = NULL;
+    record_free();
+}
@@ -0,0 +1,93 @@
+/**
+ * Record
+ *
+ * Capture what a graphics program draws as an FLC animation (see play/).
+ *
+ * While recording, draw_pixel goes through a hook that keeps a copy of the
+ * screen and the span of each row that changed. Every wait_for_retrace()
+ * ends a frame and only the changed spans are written, run length encoded,
+ * so a frame where nothing was drawn costs 16 bytes. The first frame holds
+ * the whole screen. Palette changes are passed in with RECORD_PALETTE().
+ *
+ * The file goes to the name given to RECORD_OPEN() unless the RECORD
+ * environment variable names another. Everything is compiled out unless
+ * RECORD is defined (make RECORD=1).
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "vga.h"                        // byte ushort
+
+#define FLI_MAGIC 0xAF11                // file header: 320x200 fli
+#define FLC_MAGIC 0xAF12                // file header: flc, any size
+#define FLC_FRAME 0xF1FA                // frame chunk
+#define FLC_COLOR_256 4                 // palette packets, 8 bits per component
+#define FLC_COLOR_64 11                 // palette packets, 6 bits per component
+#define FLC_LC 12                       // changed lines, run length encoded
+#define FLC_BLACK 13                    // clear the screen
+#define FLC_BYTE_RUN 15                 // whole screen, run length encoded
+#define FLC_COPY 16                     // whole screen, uncompressed
+#define FLC_FRAME_MS 14                 // one 70Hz retrace per frame
+#define FLC_MAX_PACKET 127              // longest run or literal in a packet
+
+#if defined(__DOS__) && !defined(__386__)
+typedef unsigned long dword;            // 32 bits in every build, like the file
+#else
+typedef unsigned int dword;
+#endif
+
+#pragma pack(push, 1)
+typedef struct {
+    dword size;                         // of the whole file
+    ushort magic;
+    ushort frames;
+    ushort width;
+    ushort height;
+    ushort depth;                       // bits per pixel
+    ushort flags;                       // 3 once the file is complete
+    dword speed;                        // milliseconds per frame (fli: 1/70s)
+    byte reserved1[2];
+    dword created, creator, updated, updater;
+    ushort aspect_x, aspect_y;
+    byte reserved2[38];
+    dword frame1;                       // file offset of the first frame
+    dword frame2;                       // file offset of the second frame
+    byte reserved3[40];
+} flc_header_s;
+
+typedef struct {
+    dword size;                         // including this header
+    ushort type;                        // FLC_FRAME
+    ushort chunks;
+    byte reserved[8];
+} flc_frame_s;
+
+typedef struct {
+    dword size;                         // including this header
+    ushort type;
+} flc_chunk_s;
+#pragma pack(pop)
+
+#ifdef RECORD
+
+int record_open(char *name);
+void record_close(void);
+void record_frame(void);
+void record_palette(byte *rgb, uint count);
+
+#define RECORD_OPEN(name) record_open(name)
+#define RECORD_CLOSE() record_close()
+#define RECORD_FRAME() record_frame()
+#define RECORD_PALETTE(rgb, count) record_palette(rgb, count)
+
+#else
+
+#define RECORD_OPEN(name) ((void)0)
+#define RECORD_CLOSE() ((void)0)
+#define RECORD_FRAME() ((void)0)
+#define RECORD_PALETTE(rgb, count) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,564 @@
+/**
+ * VGA
+ *
+ * Video mode setting and pixel access shared by the graphics programs.
+ */
+
+#include <string.h>                     // memcmp memcpy memset strcmp
+#include "vga.h"
+#include "prof.h"
+#include "record.h"
+
+#define VBE_OK 0x004F                   // ax after a successful VBE call
+#define VBE_GET_INFO 0x4F00             // VBE function: controller information
+#define VBE_GET_MODE_INFO 0x4F01        // VBE function: mode information
+#define VBE_SET_MODE 0x4F02             // VBE function: set mode
+#define VBE_SET_WINDOW 0x4F05           // VBE function: move a bank window
+#define VBE_USE_LFB 0x4000              // set mode flag: linear framebuffer
+#define VBE_MODE_SUPPORTED 0x0001       // mode attribute: supported by hardware
+#define VBE_MODE_GRAPHICS 0x0010        // mode attribute: graphics mode
+#define VBE_MODE_LFB 0x0080             // mode attribute: linear framebuffer available
+#define VBE_WINDOW_WRITABLE 0x05        // window attributes: exists and is writable
+#define VBE_PACKED_PIXEL 0x04           // memory model: packed pixel
+#define VBE_INFO_OFFSET 0               // controller information in the buffer
+#define VBE_MODE_INFO_OFFSET 512        // mode information in the buffer
+#define VBE_BUFFER_SIZE 768             // real mode buffer for VBE calls
+#define WINDOW_KB 64                    // size of the window moved by a bank switch
+#define DPMI_INT 0x31                   // DPMI interrupt
+#define DPMI_SIMULATE_INT 0x0300        // DPMI function: real mode interrupt
+#define DPMI_DOS_ALLOC 0x0100           // DPMI function: allocate dos memory
+#define DPMI_MAP_PHYSICAL 0x0800        // DPMI function: map physical memory
+#define DPMI_UNMAP_PHYSICAL 0x0801      // DPMI function: free a physical mapping
+
+#if defined(__DOS__) && !defined(__386__)
+#define VMEMCPY _fmemcpy                // copy to far video memory
+#define VMEMSET _fmemset
+#else
+#define VMEMCPY memcpy
+#define VMEMSET memset
+#endif
+
+#pragma pack(push, 1)
+typedef struct {
+    char signature[4];                  // "VBE2" in, "VESA" out
+    ushort version;
+    ulong oem_string;
+    ulong capabilities;
+    ulong video_modes;                  // real mode pointer to the mode list
+    ushort total_memory;                // in 64k blocks
+} vbe_info_s;
+
+typedef struct {
+    ushort attributes;
+    byte window_a_attributes;
+    byte window_b_attributes;
+    ushort window_granularity;          // in kilobytes
+    ushort window_size;                 // in kilobytes
+    ushort window_a_segment;
+    ushort window_b_segment;
+    ulong window_function;
+    ushort bytes_per_line;
+    ushort width;
+    ushort height;
+    byte char_width;
+    byte char_height;
+    byte planes;
+    byte bits_per_pixel;
+    byte banks;
+    byte memory_model;
+    byte bank_size;
+    byte image_pages;
+    byte reserved;
+    byte color_masks[9];
+    ulong physical_base;                // linear framebuffer physical address
+} vbe_mode_info_s;
+
+#ifdef __386__
+// DPMI real mode call structure
+typedef struct {
+    ulong edi, esi, ebp, reserved, ebx, edx, ecx, eax;
+    ushort flags, es, ds, fs, gs, ip, cs, sp, ss;
+} dpmi_regs_s;
+#endif
+#pragma pack(pop)
+
+#ifdef __DOS__
+byte VFAR *vga = (byte VFAR *)VIDEO_MEMORY;
+#else
+static byte screen[VBE_MAX_SCREEN_WIDTH * VBE_MAX_SCREEN_HEIGHT];
+byte *vga = screen;
+byte vga_palette[VGA_256_COLOR_NUM_COLORS * 3];
+static uint dac_index;
+#endif
+byte vga_mode;
+uint screen_width, screen_height, num_colors;
+uint screen_pitch;
+
+void (*draw_pixel)(uint x, uint y, byte color);
+
+#ifdef __DOS__
+#ifdef __386__
+static ushort vbe_segment;              // dos memory for VBE calls
+static byte *vbe_buffer;
+#else
+static byte vbe_buffer[VBE_BUFFER_SIZE];
+#endif
+static uint vbe_bank;                   // bank the window is showing now
+static uint vbe_bank_step;              // window granularity units per bank
+static ushort vbe_window;               // 0 = window a, 1 = window b
+static byte vbe_banked;                 // 1 = video memory is reached through the window
+static byte *vbe_lfb;                   // mapped linear framebuffer, NULL if none
+#endif
+
+// mode 0x13 and linear VBE modes: one byte per pixel
+void draw_pixel_256(uint x, uint y, byte color) {
+    uint offset;
+
+    offset = y * screen_pitch + x;      // slower, but easy to understand
+    //offset = (y << 8) + (y << 6) + x;   // faster, but harder to understand
+    vga[offset] = color;
+    PROF_COUNT(PROF_PIXELS, 1);
+}
+
+#ifdef __DOS__
+// mode 0x12: four bit planes, eight pixels per byte
+//
+// set_mode() enables set/reset on all planes, so the color comes from the
+// set/reset register and the bit mask picks the pixel within the byte. The
+// read loads the latches so the other seven pixels are written back as-is.
+void draw_pixel_16(uint x, uint y, byte color) {
+    volatile byte VFAR *address;
+    byte latch;
+
+    address = vga + y * (screen_width >> 3) + (x >> 3);
+    outpw(GC_INDEX, (color << 8) | GC_SET_RESET);
+    outpw(GC_INDEX, ((0x80 >> (x & 7)) << 8) | GC_BIT_MASK);
+    latch = *address;
+    *address = latch;
+    PROF_COUNT(PROF_PIXELS, 1);
+    PROF_COUNT(PROF_PORT_IO, 2);
+}
+
+// call a VBE function with es:di pointing offset bytes into vbe_buffer
+ushort vbe_call(ushort function, ushort bx, ushort cx, ushort dx, ushort offset) {
+#ifdef __386__
+    dpmi_regs_s dpmi;
+    union REGS regs;
+    struct SREGS sregs;
+
+    memset(&dpmi, 0, sizeof(dpmi));
+    dpmi.eax = function;
+    dpmi.ebx = bx;
+    dpmi.ecx = cx;
+    dpmi.edx = dx;
+    dpmi.es = vbe_segment;
+    dpmi.edi = offset;
+
+    segread(&sregs);
+    regs.w.ax = DPMI_SIMULATE_INT;
+    regs.h.bl = VIDEO_INT;
+    regs.h.bh = 0;
+    regs.w.cx = 0;
+    sregs.es = FP_SEG(&dpmi);
+    regs.x.edi = FP_OFF(&dpmi);
+    int386x(DPMI_INT, &regs, &regs, &sregs);
+
+    return (ushort)dpmi.eax;
+#else
+    union REGS regs;
+    struct SREGS sregs;
+    byte far *buffer = (byte far *)vbe_buffer + offset;
+
+    segread(&sregs);
+    regs.x.ax = function;
+    regs.x.bx = bx;
+    regs.x.cx = cx;
+    regs.x.dx = dx;
+    sregs.es = FP_SEG(buffer);
+    regs.x.di = FP_OFF(buffer);
+    int86x(VIDEO_INT, &regs, &regs, &sregs);
+
+    return regs.x.ax;
+#endif
+}
+
+// turn a real mode segment:offset pointer into one this program can use
+void VFAR *real_pointer(ulong pointer) {
+#ifdef __386__
+    return (void *)(((pointer >> 16) << 4) + (pointer & 0xFFFF));
+#else
+    return (void far *)pointer;
+#endif
+}
+
+int vbe_init(void) {
+#ifdef __386__
+    union REGS regs;
+
+    if (vbe_buffer != NULL) return 1;
+    regs.w.ax = DPMI_DOS_ALLOC;
+    regs.w.bx = VBE_BUFFER_SIZE / 16;
+    int386(DPMI_INT, &regs, &regs);
+    if (regs.x.cflag) return 0;
+    vbe_segment = regs.w.ax;
+    vbe_buffer = (byte *)((ulong)vbe_segment << 4);
+#endif
+    return 1;
+}
+
+// map the linear framebuffer into the address space, 0 if it can not be
+byte *vbe_map_lfb(ulong physical, ulong size) {
+#ifdef __386__
+    union REGS regs;
+
+    regs.w.ax = DPMI_MAP_PHYSICAL;
+    regs.w.bx = (ushort)(physical >> 16);
+    regs.w.cx = (ushort)physical;
+    regs.w.si = (ushort)(size >> 16);
+    regs.w.di = (ushort)size;
+    int386(DPMI_INT, &regs, &regs);
+    if (regs.x.cflag) return NULL;
+    return (byte *)(((ulong)regs.w.bx << 16) | regs.w.cx);
+#else
+    // real mode can not reach memory above 1MB
+    return NULL;
+#endif
+}
+
+// free a mapping made by vbe_map_lfb()
+void vbe_unmap_lfb(byte *lfb) {
+#ifdef __386__
+    union REGS regs;
+
+    if (lfb == NULL) return;
+    regs.w.ax = DPMI_UNMAP_PHYSICAL;
+    regs.w.bx = (ushort)((ulong)lfb >> 16);
+    regs.w.cx = (ushort)(ulong)lfb;
+    int386(DPMI_INT, &regs, &regs);
+#endif
+}
+
+void vbe_set_bank(uint bank) {
+    vbe_bank = bank;
+    vbe_call(VBE_SET_WINDOW, vbe_window, 0, bank * vbe_bank_step, 0);
+}
+
+// VBE modes without a linear framebuffer: a 64k window onto video memory
+void draw_pixel_banked(uint x, uint y, byte color) {
+    ulong offset;
+    uint bank;
+
+    offset = (ulong)y * screen_pitch + x;
+    bank = (uint)(offset >> 16);
+    if (bank != vbe_bank) vbe_set_bank(bank);
+    vga[(uint)offset & 0xFFFF] = color;
+    PROF_COUNT(PROF_PIXELS, 1);
+}
+
+void set_mode(byte mode) {
+    union REGS regs;
+
+    regs.h.ah = SET_MODE;
+    regs.h.al = mode;
+    INT86(VIDEO_INT, &regs, &regs);
+
+    vga = (byte VFAR *)VIDEO_MEMORY;
+    vbe_banked = 0;
+    vbe_unmap_lfb(vbe_lfb);
+    vbe_lfb = NULL;
+    vga_mode = mode;
+    if (mode == VGA_16_COLOR_MODE) {
+        screen_width = VGA_16_COLOR_SCREEN_WIDTH;
+        screen_height = VGA_16_COLOR_SCREEN_HEIGHT;
+        num_colors = VGA_16_COLOR_NUM_COLORS;
+        draw_pixel = draw_pixel_16;
+        outpw(GC_INDEX, 0x0F00 | GC_ENABLE_SET_RESET);
+        PROF_COUNT(PROF_PORT_IO, 1);
+    } else {
+        screen_width = VGA_256_COLOR_SCREEN_WIDTH;
+        screen_height = VGA_256_COLOR_SCREEN_HEIGHT;
+        num_colors = VGA_256_COLOR_NUM_COLORS;
+        draw_pixel = draw_pixel_256;
+    }
+    screen_pitch = screen_width;
+}
+
+// find a 256 color VBE mode of the given size and set it; returns 0 if none
+int set_vbe_mode(uint width, uint height) {
+    vbe_info_s *info;
+    vbe_mode_info_s *mode_info;
+    ushort VFAR *modes;
+    ushort mode, segment, window, granularity;
+    uint pitch;
+    byte banked;
+    byte *lfb = NULL;
+
+    if (!vbe_init()) return 0;
+    info = (vbe_info_s *)(vbe_buffer + VBE_INFO_OFFSET);
+    mode_info = (vbe_mode_info_s *)(vbe_buffer + VBE_MODE_INFO_OFFSET);
+
+    // asking with "VBE2" gets the VBE 2.0 fields filled in
+    memcpy(info->signature, "VBE2", 4);
+    if (vbe_call(VBE_GET_INFO, 0, 0, 0, VBE_INFO_OFFSET) != VBE_OK) return 0;
+    if (memcmp(info->signature, "VESA", 4) != 0) return 0;
+
+    for (modes = real_pointer(info->video_modes); *modes != 0xFFFF; modes++) {
+        mode = *modes;
+        if (vbe_call(VBE_GET_MODE_INFO, 0, mode, 0, VBE_MODE_INFO_OFFSET) != VBE_OK) continue;
+        if ((mode_info->attributes & (VBE_MODE_SUPPORTED | VBE_MODE_GRAPHICS))
+            != (VBE_MODE_SUPPORTED | VBE_MODE_GRAPHICS)) continue;
+        if (mode_info->width != width || mode_info->height != height) continue;
+        if (mode_info->bits_per_pixel != 8 || mode_info->memory_model != VBE_PACKED_PIXEL) continue;
+        break;
+    }
+    if (*modes == 0xFFFF) return 0;
+
+    // the window used when there is no linear framebuffer; it has to be
+    // writable and move in steps that divide WINDOW_KB
+    granularity = mode_info->window_granularity;
+    if (granularity == 0) granularity = WINDOW_KB;
+    banked = (mode_info->window_size >= WINDOW_KB && granularity <= WINDOW_KB
+        && WINDOW_KB % granularity == 0);
+    if ((mode_info->window_a_attributes & VBE_WINDOW_WRITABLE) == VBE_WINDOW_WRITABLE) {
+        window = 0;
+        segment = mode_info->window_a_segment;
+    } else if ((mode_info->window_b_attributes & VBE_WINDOW_WRITABLE) == VBE_WINDOW_WRITABLE) {
+        window = 1;
+        segment = mode_info->window_b_segment;
+    } else {
+        window = segment = 0;
+        banked = 0;
+    }
+
+    // nothing global changes until the mode is set, so a failure leaves the
+    // current mode usable
+    pitch = mode_info->bytes_per_line;
+    if (info->version >= 0x0200 && (mode_info->attributes & VBE_MODE_LFB)) {
+        lfb = vbe_map_lfb(mode_info->physical_base, (ulong)pitch * height);
+    }
+    if (lfb != NULL && vbe_call(VBE_SET_MODE, mode | VBE_USE_LFB, 0, 0, 0) != VBE_OK) {
+        vbe_unmap_lfb(lfb);
+        lfb = NULL;
+    }
+
+    if (lfb != NULL) {
+        vbe_unmap_lfb(vbe_lfb);
+        vbe_lfb = lfb;
+        vga = lfb;
+        vbe_banked = 0;
+        draw_pixel = draw_pixel_256;
+    } else {
+        if (!banked) return 0;
+        if (vbe_call(VBE_SET_MODE, mode, 0, 0, 0) != VBE_OK) return 0;
+        vbe_unmap_lfb(vbe_lfb);
+        vbe_lfb = NULL;
+        vbe_window = window;
+        vbe_bank_step = WINDOW_KB / granularity;
+        vga = real_pointer((ulong)segment << 16);
+        vbe_set_bank(0);
+        vbe_banked = 1;
+        draw_pixel = draw_pixel_banked;
+    }
+
+    vga_mode = VBE_MODE;
+    screen_width = width;
+    screen_height = height;
+    screen_pitch = pitch;
+    num_colors = VGA_256_COLOR_NUM_COLORS;
+    return 1;
+}
+
+void wait_for_retrace(void) {
+    RECORD_FRAME();
+    PROF_BEGIN(PROF_RETRACE);
+    while(inp(INPUT_STATUS) & VRTRACE_BIT) PROF_COUNT(PROF_PORT_IO, 1);
+    while(!(inp(INPUT_STATUS) & VRTRACE_BIT)) PROF_COUNT(PROF_PORT_IO, 1);
+    PROF_COUNT(PROF_PORT_IO, 2);
+    PROF_END(PROF_RETRACE);
+}
+#else
+// like the BIOS, clear the screen and load the default palette
+void set_mode(byte mode) {
+    vga_mode = mode;
+    if (mode == VGA_16_COLOR_MODE) {
+        screen_width = VGA_16_COLOR_SCREEN_WIDTH;
+        screen_height = VGA_16_COLOR_SCREEN_HEIGHT;
+        num_colors = VGA_16_COLOR_NUM_COLORS;
+    } else {
+        screen_width = VGA_256_COLOR_SCREEN_WIDTH;
+        screen_height = VGA_256_COLOR_SCREEN_HEIGHT;
+        num_colors = VGA_256_COLOR_NUM_COLORS;
+    }
+    screen_pitch = screen_width;
+    draw_pixel = draw_pixel_256;
+    // only the new mode's area; clearing all of screen would dominate the
+    // timing of the faster tests
+    memset(screen, 0, (ulong)screen_pitch * screen_height);
+    vga_default_palette(vga_palette);
+    dac_index = 0;
+}
+
+int set_vbe_mode(uint width, uint height) {
+    if (width > VBE_MAX_SCREEN_WIDTH || height > VBE_MAX_SCREEN_HEIGHT) return 0;
+    set_mode(VGA_256_COLOR_MODE);
+    vga_mode = VBE_MODE;
+    screen_width = width;
+    screen_height = height;
+    screen_pitch = width;
+    memset(screen, 0, (ulong)screen_pitch * screen_height);
+    return 1;
+}
+
+void wait_for_retrace(void) {
+    RECORD_FRAME();
+}
+
+// emulate the DAC write ports, anything else is ignored
+unsigned outp(unsigned port, unsigned value) {
+    if (port == PALETTE_INDEX) {
+        dac_index = (value & 0xFF) * 3;
+    } else if (port == PALETTE_DATA) {
+        vga_palette[dac_index] = value & 0x3F;
+        dac_index = (dac_index + 1) % sizeof(vga_palette);
+    }
+    return value;
+}
+#endif
+
+// copy count pixels to row y from x on in a 256 color mode
+void copy_span(uint x, uint y, byte *source, uint count) {
+    ulong offset;
+#ifdef __DOS__
+    ulong room;
+    uint part;
+#endif
+
+    PROF_COUNT(PROF_PIXELS, count);
+    offset = (ulong)y * screen_pitch + x;
+#ifdef __DOS__
+    if (vbe_banked) {
+        // split the span where it crosses into the next bank
+        for (; count > 0; count -= part) {
+            if ((uint)(offset >> 16) != vbe_bank) vbe_set_bank((uint)(offset >> 16));
+            room = 0x10000L - (offset & 0xFFFF);
+            part = (room < count) ? (uint)room : count;
+            VMEMCPY(vga + (uint)(offset & 0xFFFF), source, part);
+            source += part;
+            offset += part;
+        }
+        return;
+    }
+#endif
+    VMEMCPY(vga + (uint)offset, source, count);
+}
+
+// set count pixels of row y from x on to color in a 256 color mode
+void fill_span(uint x, uint y, byte color, uint count) {
+    ulong offset;
+#ifdef __DOS__
+    ulong room;
+    uint part;
+#endif
+
+    PROF_COUNT(PROF_PIXELS, count);
+    offset = (ulong)y * screen_pitch + x;
+#ifdef __DOS__
+    if (vbe_banked) {
+        for (; count > 0; count -= part) {
+            if ((uint)(offset >> 16) != vbe_bank) vbe_set_bank((uint)(offset >> 16));
+            room = 0x10000L - (offset & 0xFFFF);
+            part = (room < count) ? (uint)room : count;
+            VMEMSET(vga + (uint)(offset & 0xFFFF), color, part);
+            offset += part;
+        }
+        return;
+    }
+#endif
+    VMEMSET(vga + (uint)offset, color, count);
+}
+
+// "lo" is 320x200 (mode 0x13), "640", "800" and "1024" are VBE modes
+int parse_resolution(char *arg, uint *width, uint *height) {
+    if (strcmp(arg, "lo") == 0) {
+        *width = VGA_256_COLOR_SCREEN_WIDTH;
+        *height = VGA_256_COLOR_SCREEN_HEIGHT;
+    } else if (strcmp(arg, "640") == 0) {
+        *width = 640;
+        *height = 480;
+    } else if (strcmp(arg, "800") == 0) {
+        *width = 800;
+        *height = 600;
+    } else if (strcmp(arg, "1024") == 0) {
+        *width = 1024;
+        *height = 768;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+// set a 256 color mode of the given size; returns 0 if there is none
+int set_resolution(uint width, uint height) {
+    if (width == VGA_256_COLOR_SCREEN_WIDTH && height == VGA_256_COLOR_SCREEN_HEIGHT) {
+        set_mode(VGA_256_COLOR_MODE);
+        return 1;
+    }
+    return set_vbe_mode(width, height);
+}
+
+void wait(ushort time) {
+    ushort i;
+
+    for (i = 0; i < time; i++) {
+        wait_for_retrace();
+    }
+}
+
+// the palette the BIOS loads for mode 0x13, as 6-bit red, green, blue
+void vga_default_palette(byte *palette) {
+    static byte ega[16][3] = {
+        {  0,  0,  0 }, {  0,  0, 42 }, {  0, 42,  0 }, {  0, 42, 42 },
+        { 42,  0,  0 }, { 42,  0, 42 }, { 42, 21,  0 }, { 42, 42, 42 },
+        { 21, 21, 21 }, { 21, 21, 63 }, { 21, 63, 21 }, { 21, 63, 63 },
+        { 63, 21, 21 }, { 63, 21, 63 }, { 63, 63, 21 }, { 63, 63, 63 }
+    };
+    static byte grays[16] = {
+        0, 5, 8, 11, 14, 17, 20, 24, 28, 32, 36, 40, 45, 50, 56, 63
+    };
+    // high, low, and very low intensity, each at high, medium, and low saturation
+    static byte levels[9][5] = {
+        {  0, 16, 31, 47, 63 }, { 31, 39, 47, 55, 63 }, { 45, 49, 54, 58, 63 },
+        {  0,  7, 14, 21, 28 }, { 14, 17, 21, 24, 28 }, { 20, 22, 24, 26, 28 },
+        {  0,  4,  8, 12, 16 }, {  8, 10, 12, 14, 16 }, { 11, 12, 13, 15, 16 }
+    };
+    // hue wheel from blue through red, yellow, green, and cyan: level of r, g, b
+    static byte wheel[24][3] = {
+        { 0, 0, 4 }, { 1, 0, 4 }, { 2, 0, 4 }, { 3, 0, 4 },
+        { 4, 0, 4 }, { 4, 0, 3 }, { 4, 0, 2 }, { 4, 0, 1 },
+        { 4, 0, 0 }, { 4, 1, 0 }, { 4, 2, 0 }, { 4, 3, 0 },
+        { 4, 4, 0 }, { 3, 4, 0 }, { 2, 4, 0 }, { 1, 4, 0 },
+        { 0, 4, 0 }, { 0, 4, 1 }, { 0, 4, 2 }, { 0, 4, 3 },
+        { 0, 4, 4 }, { 0, 3, 4 }, { 0, 2, 4 }, { 0, 1, 4 }
+    };
+    uint i, j;
+
+    for (i = 0; i < 16; i++) {
+        *palette++ = ega[i][0];
+        *palette++ = ega[i][1];
+        *palette++ = ega[i][2];
+    }
+    for (i = 0; i < 16; i++) {
+        *palette++ = grays[i];
+        *palette++ = grays[i];
+        *palette++ = grays[i];
+    }
+    for (i = 0; i < 9; i++) {
+        for (j = 0; j < 24; j++) {
+            *palette++ = levels[i][wheel[j][0]];
+            *palette++ = levels[i][wheel[j][1]];
+            *palette++ = levels[i][wheel[j][2]];
+        }
+    }
+    // the last eight entries are black
+    memset(palette, 0, 8 * 3);
+}
@@ -0,0 +1,97 @@
+/**
+ * VGA
+ *
+ * Video mode setting and pixel access shared by the graphics programs.
+ *
+ * Built with wcl (-bcl=dos) the programs run in 16-bit real mode and video
+ * memory is reached through a far segment:offset pointer. Built with wcl386
+ * (-bcl=dos4g) they run under a 32-bit DOS extender, video memory is a near
+ * pointer into the flat address space, and uint is 32 bits wide.
+ *
+ * Resolutions above 320x200 use a VESA VBE 2.0 mode with 256 colors. The
+ * 32-bit build draws through the linear framebuffer when the card has one;
+ * otherwise (and always in the 16-bit build) the 64k window is moved with
+ * bank switching, only when a pixel falls outside the current bank.
+ *
+ * Built for any other host (see test/) video memory is an off-screen buffer
+ * with one byte per pixel in every mode, palette port writes go to an
+ * emulated DAC in vga_palette, and kbhit/getch come from the host program.
+ */
+
+#ifndef VGA_H
+#define VGA_H
+
+#ifdef __DOS__
+#include <conio.h>                      // inp outp outpw getch kbhit
+#include <dos.h>                        // int86 int386
+#endif
+
+#define VIDEO_INT 0x10                  // BIOS video interrupt
+#define SET_MODE 0x00                   // BIOS function to set video mode
+#define VGA_16_COLOR_MODE 0x12          // use to set 16 color VGA mode
+#define VGA_256_COLOR_MODE 0x13         // use to set 256 color VGA mode
+#define TEXT_MODE 0x03                  // use to set text mode
+#define PIXEL_PLOT 0x0C                 // BIOS function to plot a pixel
+#define VGA_16_COLOR_SCREEN_WIDTH 640   // width in pixels of VGA mode 0x12
+#define VGA_16_COLOR_SCREEN_HEIGHT 480  // height in pixels of VGA mode 0x12
+#define VGA_16_COLOR_NUM_COLORS 16      // number of colors in VGA mode 0x12
+#define VGA_256_COLOR_SCREEN_WIDTH 320  // width in pixels of VGA mode 0x13
+#define VGA_256_COLOR_SCREEN_HEIGHT 200 // height in pixels of VGA mode 0x13
+#define VGA_256_COLOR_NUM_COLORS 256    // number of colors in VGA mode 0x13
+#define PALETTE_INDEX 0x3C8             // use to reset palette index
+#define PALETTE_DATA 0x3C9              // use to write colors to palette
+#define GC_INDEX 0x3CE                  // vga graphics controller index register
+#define GC_SET_RESET 0x00               // graphics controller: set/reset color
+#define GC_ENABLE_SET_RESET 0x01        // graphics controller: planes using set/reset
+#define GC_BIT_MASK 0x08                // graphics controller: bits to write
+#define INPUT_STATUS 0x3DA              // vga status register
+#define VRTRACE_BIT 0x08                // 1 = vertical retrace, ram access ok for 1.25ms
+#define VBE_MODE 0xFF                   // vga_mode value while in a VBE mode
+#define VBE_MAX_SCREEN_WIDTH 1024       // largest VBE resolution offered
+#define VBE_MAX_SCREEN_HEIGHT 768
+
+#if !defined(__DOS__)
+#define VFAR                            // video memory is an off-screen buffer
+#elif defined(__386__)
+#define VIDEO_MEMORY 0xA0000L           // flat address of video memory
+#define VFAR                            // video memory is a near pointer
+#define INT86 int386                    // call real mode interrupts through the extender
+#else
+#define VIDEO_MEMORY 0xA0000000L        // segment:offset of video memory
+#define VFAR far                        // video memory is a far pointer
+#define INT86 int86
+#endif
+
+typedef unsigned char byte;
+typedef unsigned short ushort;
+typedef unsigned int uint;              // native word: 16 bits under dos, 32 under dos4g
+typedef unsigned long ulong;
+
+extern byte VFAR *vga;                  // start of video memory
+extern byte vga_mode;                   // current video mode
+extern uint screen_width, screen_height, num_colors;
+extern uint screen_pitch;               // bytes from one row to the next
+#ifndef __DOS__
+extern byte vga_palette[VGA_256_COLOR_NUM_COLORS * 3];
+#endif
+
+// plot one pixel in the current video mode, set by set_mode() or set_vbe_mode()
+extern void (*draw_pixel)(uint x, uint y, byte color);
+
+void set_mode(byte mode);
+int set_vbe_mode(uint width, uint height);
+int parse_resolution(char *arg, uint *width, uint *height);
+int set_resolution(uint width, uint height);
+void copy_span(uint x, uint y, byte *source, uint count);
+void fill_span(uint x, uint y, byte color, uint count);
+void wait_for_retrace(void);
+void wait(ushort time);
+void vga_default_palette(byte *palette);
+
+#ifndef __DOS__
+unsigned outp(unsigned port, unsigned value);
+int kbhit(void);
+int getch(void);
+#endif
+
+#endif
@@ -6,64 +6,22 @@
  * https://en.wikipedia.org/wiki/Bresenham%27s_line_algorithm
  */
 
-#include <conio.h>                      // clrscr getch
-#include <dos.h>                        // int86 outp inp
 #include <math.h>                       // sin
 #include <stdio.h>                      // printf sprintf
 #include <stdlib.h>                     // EXIT_SUCCESS EXIT_FAILURE malloc
+#include "vga.h"                        // set_mode draw_pixel wait_for_retrace
+#include "prof.h"                       // PROF_BEGIN PROF_END
+#include "record.h"                     // RECORD_OPEN RECORD_CLOSE
+#include "keyboard.h"                   // kb_init kb_wait
 
-#define VIDEO_INT 0x10                  // BIOS video interrupt
-#define SET_MODE 0x00                   // BIOS function to set video mode
-#define VGA_256_COLOR_MODE 0x13         // use to set 256 color VGA mode
-#define TEXT_MODE 0x03                  // use to set text mode
-#define PIXEL_PLOT 0x0C                 // BIOS function to plot a pixel
-#define VIDEO_MEMORY 0xA0000000L        // start of video memory
-#define SCREEN_WIDTH 320                // width in pixels of VGA mode 0x13
-#define SCREEN_HEIGHT 200               // height in pixels of VGA mode 0x13
 #define NUM_COLORS 256                  // number of colors in VGA mode
-#define INPUT_STATUS 0x3DA              // vga status register
-#define VRTRACE_BIT 0x08                // 1 = vertical retrace, ram access ok for 1.25ms
 #define PI 3.14159265359                // PI
 
 // use all colors except black (0)
 #define RANDOM_COLOR() (rand() % (NUM_COLORS - 1) + 1)
 
-typedef unsigned char byte;
-typedef unsigned short ushort;
-
-byte far *VGA = (byte far *)VIDEO_MEMORY;
-
-void wait_for_retrace() {
-    while(inp(INPUT_STATUS) & VRTRACE_BIT);
-    while(!(inp(INPUT_STATUS) & VRTRACE_BIT));
-}
-
-void wait(ushort time) {
-    ushort i;
-
-    for (i = 0; i < time; i++) {
-        wait_for_retrace();
-    }
-}
-
-void set_mode(byte mode) {
-    union REGS regs;
-
-    regs.h.ah = SET_MODE;
-    regs.h.al = mode;
-    int86(VIDEO_INT, &regs, &regs);
-}
-
-void draw_pixel(ushort x, ushort y, byte color) {
-    ushort offset;
-
-    offset = y * SCREEN_WIDTH + x;      // slower, but easy to understand
-    //offset = (y<<8) + (y<<6) + x;       // faster, but harder to understand
-    VGA[offset] = color;
-}
-
-void draw_line(ushort x1, ushort y1, ushort x2, ushort y2, byte color) {
-    ushort x, y;
+void draw_line(uint x1, uint y1, uint x2, uint y2, byte color) {
+    uint x, y;
     int dx, dy, sx, sy, e1, e2;
 
     dx = x2 - x1;
@@ -74,11 +32,13 @@ void draw_line(ushort x1, ushort y1, ushort x2, ushort y2, byte color) {
     sy = (y1 < y2) ? 1 : -1;
     e1 = dx + dy;
 
+    PROF_BEGIN(PROF_DRAW_LINE);
+
     x = x1;
     y = y1;
 
     while (1) {
-        if (x < SCREEN_WIDTH && y < SCREEN_HEIGHT) {
+        if (x < screen_width && y < screen_height) {
             draw_pixel(x, y, color);
         }
         if (x == x2 && y == y2) break;
@@ -94,41 +54,68 @@ void draw_line(ushort x1, ushort y1, ushort x2, ushort y2, byte color) {
             y += sy;
         }
     }
+
+    PROF_END(PROF_DRAW_LINE);
 }
 
-double degrees_to_radians(ushort degree) {
+double degrees_to_radians(uint degree) {
     return degree * PI / 180.0;
 }
 
 void draw_lines() {
-    ushort x1, y1, x2, y2, deg;
+    uint x1, y1, x2, y2, deg;
     byte color;
 
     x1 = 0;
     y1 = 0;
-    x2 = SCREEN_WIDTH - 1;
+    x2 = screen_width - 1;
     y2 = 0;
     color = 1;
 
     for (deg = 0; deg <= 90; deg += 1) {
         wait_for_retrace();
         draw_line(x1, y1, x2, y2, color);
-        y2 = (ushort)((SCREEN_HEIGHT - 1) * sin(degrees_to_radians(deg)));
+        y2 = (uint)((screen_height - 1) * sin(degrees_to_radians(deg)));
     }
-    y2 = SCREEN_HEIGHT - 1;
+    y2 = screen_height - 1;
     for (deg = 90; deg <= 180; deg += 1) {
         wait_for_retrace();
         draw_line(x1, y1, x2, y2, color);
-        x2 = (ushort)((SCREEN_WIDTH - 1) * sin(degrees_to_radians(deg)));
+        x2 = (uint)((screen_width - 1) * sin(degrees_to_radians(deg)));
     }
 }
 
-int main(void) {
-    set_mode(VGA_256_COLOR_MODE);
+int main(int argc, char *argv[]) {
+    uint width = VGA_256_COLOR_SCREEN_WIDTH;
+    uint height = VGA_256_COLOR_SCREEN_HEIGHT;
+
+    if (argc > 2 || (argc == 2 && !parse_resolution(argv[1], &width, &height))) {
+        printf("Usage: %s [lo|640|800|1024]\n", argv[0]);
+        printf("Where:\n");
+        printf("  lo   - VGA 256 color mode (320x200), the default\n");
+        printf("  640  - VESA VBE 256 color mode (640x480)\n");
+        printf("  800  - VESA VBE 256 color mode (800x600)\n");
+        printf("  1024 - VESA VBE 256 color mode (1024x768)\n");
+        return EXIT_FAILURE;
+    }
+
+    PROF_INIT();
+
+    if (!set_resolution(width, height)) {
+        printf("No VESA VBE 256 color mode at %ux%u\n", width, height);
+        return EXIT_FAILURE;
+    }
+
+    kb_init();
+
+    RECORD_OPEN("LINES.FLC");
 
     draw_lines();
 
-    getch();
+    RECORD_CLOSE();
+
+    PROF_OVERLAY();
+    kb_wait();
 
     set_mode(TEXT_MODE);
 
@@ -3,31 +3,35 @@
  *
  * Draw colored Mandelbrot.
  *
+ * Each picture is computed with the cheapest number type that still tells
+ * neighboring pixels apart: 16-bit fixed point for the full view, then
+ * float, 32-bit fixed point, double, and finally double-double (a pair of
+ * doubles, about 106 bits) as the view is zoomed in.
+ *
  * Inspiration: https://github.com/ms0g/dosbrot/blob/main/SRC/DOSBROT.C
  */
 
-#include <conio.h>                      // clrscr getch kbhit
-#include <dos.h>                        // int86 outp inp
-#include <stdlib.h>                     // EXIT_SUCCESS EXIT_FAILURE malloc
-
-#define VIDEO_INT 0x10                  // BIOS video interrupt
-#define SET_MODE 0x00                   // BIOS function to set video mode
-#define VGA_16_COLOR_MODE 0x12          // use to set 16 color VGA mode
-#define VGA_256_COLOR_MODE 0x13         // use to set 256 color VGA mode
-#define TEXT_MODE 0x03                  // use to set text mode
-#define PIXEL_PLOT 0x0C                 // BIOS function to plot a pixel
-#define VIDEO_MEMORY 0xA0000000L        // start of video memory
-#define VGA_256_COLOR_SCREEN_WIDTH 320  // width in pixels of VGA mode 0x13
-#define VGA_256_COLOR_SCREEN_HEIGHT 200 // height in pixels of VGA mode 0x13
-#define VGA_256_COLOR_NUM_COLORS 256    // number of colors in VGA mode 0x13
-#define PALETTE_INDEX 0x3C8             // use to reset palette index
-#define PALETTE_DATA 0x3C9              // use to write colors to palette
-#define INPUT_STATUS 0x3DA              // vga status register
-#define VRTRACE_BIT 0x08                // 1 = vertical retrace, ram access ok for 1.25ms
-
-typedef unsigned char byte;
-typedef unsigned short ushort;
+#include <float.h>                      // _control87
+#include <stdio.h>                      // printf sprintf fopen fwrite fseek ferror
+#include <stdlib.h>                     // EXIT_SUCCESS EXIT_FAILURE atof strtoul
+#include <string.h>                     // strcmp strlen memcmp
+#include "vga.h"                        // set_mode draw_pixel wait_for_retrace kbhit getch
+#include "prof.h"                       // PROF_BEGIN PROF_END
+#include "record.h"                     // RECORD_OPEN RECORD_FRAME RECORD_CLOSE
+#include "keyboard.h"                   // kb_init kb_hit kb_wait
 
+#define MAX_ITERATIONS 100              // points still bounded after this are inside
+#define BAND_ROWS 16                    // ppm rows written between resume points
+#define CHUNK_PIXELS 512                // ppm pixels colored per write
+#define MAX_HEADER 200                  // ppm header with the view in a comment
+#define MAX_PPM_BYTES 0x7FFFFF00L       // largest ppm fseek can reach
+#define PAN_STEP 4                      // arrow keys move 1/PAN_STEP of the view
+#define ZOOM_STEP 2.0                   // + and - zoom by this much
+#define FIXED16_SHIFT 12                // fraction bits of 16-bit fixed point
+#define FIXED32_SHIFT 28                // fraction bits of 32-bit fixed point
+#define FIXED_RANGE 2.0                 // fixed point views must lie within +/- this
+#define STEPS_PER_PIXEL 16              // resolution wanted between two pixels
+#define DD_SPLIT 134217729.0            // 2^27 + 1, splits a double in two halves
 
 enum COLORS {
     // dark colors
@@ -66,28 +70,46 @@ static char palette[12] = {
     GREEN
 };
 
-byte far *vga = (byte far *)VIDEO_MEMORY;
+// number types for compute_mandelbrot, from cheapest to most precise
+enum PRECISIONS {
+    PRECISION_FIXED16,
+    PRECISION_FLOAT,
+    PRECISION_FIXED32,
+    PRECISION_DOUBLE,
+    PRECISION_DOUBLE_DOUBLE,
+    PRECISION_AUTO                      // pick by pixel spacing
+};
 
-void wait_for_retrace() {
-    while(inp(INPUT_STATUS) & VRTRACE_BIT);
-    while(!(inp(INPUT_STATUS) & VRTRACE_BIT));
-}
+// smallest step each type resolves for values up to 2 in size
+static double precision_steps[PRECISION_DOUBLE_DOUBLE] = {
+    2.44140625e-04,                     // 2^-12
+    2.384185791015625e-07,              // 2^-22
+    3.7252902984619140625e-09,          // 2^-28
+    4.4408920985006262e-16              // 2^-51
+};
 
-void set_mode(byte mode) {
-    union REGS regs;
+static char *precision_names[PRECISION_AUTO] = {
+    "fixed16", "float", "fixed32", "double", "double-double"
+};
 
-    regs.h.ah = SET_MODE;
-    regs.h.al = mode;
-    int86(VIDEO_INT, &regs, &regs);
-}
+// a double-double: hi + lo where lo holds the bits that do not fit in hi
+typedef struct {
+    double hi, lo;
+} dd_s;
 
-void draw_pixel(ushort x, ushort y, byte color) {
-    ushort offset;
+typedef struct {
+    dd_s re, im;                        // center
+    double width, height;               // size in the complex plane
+} view_s;
 
-    offset = y * VGA_256_COLOR_SCREEN_WIDTH + x; // slower, but easy to understand
-    // offset = (y<<8) + (y<<6) + x;       // faster, but harder to understand
-    vga[offset] = color;
-}
+view_s view = { { -0.5, 0.0 }, { 0.0, 0.0 }, 3.0, 2.0 };
+int precision = PRECISION_AUTO;         // number type to use, fixed point only within FIXED_RANGE
+byte interactive;                       // 1 = a key press cuts a redraw short
+
+// the pixel grid being computed, see set_grid()
+int grid_precision;
+double grid_remin, grid_immax, grid_dx, grid_dy;
+dd_s grid_dd_remin, grid_dd_immax;
 
 int compute_mandelbrot(double re, double im, int iteration) {
     int i;
@@ -110,42 +132,443 @@ int compute_mandelbrot(double re, double im, int iteration) {
     return iteration;
 }
 
-void draw_mandelbrot() {
-    int x, y, value;
-    double im;
+// compute_mandelbrot() in 16-bit fixed point; with re and im within
+// FIXED_RANGE and r2 + i2 <= 4 every value stays within +/-6, so 3 integer
+// bits are enough
+int compute_mandelbrot_fixed16(short re, short im, int iteration) {
+    int i;
+    long r2, i2;
+    short zR = re;
+    short zI = im;
+
+    for (i = 0; i < iteration; ++i) {
+        r2 = ((long)zR * zR) >> FIXED16_SHIFT;
+        i2 = ((long)zI * zI) >> FIXED16_SHIFT;
+
+        if (r2 + i2 > (4L << FIXED16_SHIFT)) {
+            return i;
+        }
+
+        zI = (short)((((long)zR * zI) >> (FIXED16_SHIFT - 1)) + im);
+        zR = (short)(r2 - i2 + re);
+    }
+
+    return iteration;
+}
+
+// compute_mandelbrot() in 32-bit fixed point, squares are 64 bits wide
+int compute_mandelbrot_fixed32(long re, long im, int iteration) {
+    int i;
+    long long r2, i2;
+    long zR = re;
+    long zI = im;
+
+    for (i = 0; i < iteration; ++i) {
+        r2 = ((long long)zR * zR) >> FIXED32_SHIFT;
+        i2 = ((long long)zI * zI) >> FIXED32_SHIFT;
+
+        if (r2 + i2 > (4LL << FIXED32_SHIFT)) {
+            return i;
+        }
+
+        zI = (long)((((long long)zR * zI) >> (FIXED32_SHIFT - 1)) + im);
+        zR = (long)(r2 - i2 + re);
+    }
+
+    return iteration;
+}
+
+int compute_mandelbrot_float(float re, float im, int iteration) {
+    int i;
+    float r2, i2;
+    float zR = re;
+    float zI = im;
+
+    for (i = 0; i < iteration; ++i) {
+        r2 = zR * zR;
+        i2 = zI * zI;
+
+        if (r2 + i2 > 4.0f) {
+            return i;
+        }
+
+        zI = 2.0f * zR * zI + im;
+        zR = r2 - i2 + re;
+    }
+
+    return iteration;
+}
+
+// a + b with the rounding error in lo (Knuth's two-sum)
+dd_s dd_add(dd_s a, dd_s b) {
+    dd_s sum;
+    double s, v, e;
+
+    s = a.hi + b.hi;
+    v = s - a.hi;
+    e = (a.hi - (s - v)) + (b.hi - v) + a.lo + b.lo;
+    sum.hi = s + e;
+    sum.lo = e - (sum.hi - s);
+    return sum;
+}
 
-    const double remin = -2.0;
-    const double remax = 1.0;
-    const double immin = -1.0;
-    const double immax = 1.0;
+// a * b with the rounding error in lo (Dekker's product, no fused multiply)
+dd_s dd_mul(dd_s a, dd_s b) {
+    dd_s product;
+    double p, e, t, a_hi, a_lo, b_hi, b_lo;
 
-    const double dx = (remax - remin) / (VGA_256_COLOR_SCREEN_WIDTH - 1);
-    const double dy = (immax - immin) / (VGA_256_COLOR_SCREEN_HEIGHT - 1);
+    t = DD_SPLIT * a.hi;
+    a_hi = t - (t - a.hi);
+    a_lo = a.hi - a_hi;
+    t = DD_SPLIT * b.hi;
+    b_hi = t - (t - b.hi);
+    b_lo = b.hi - b_hi;
+
+    p = a.hi * b.hi;
+    e = ((a_hi * b_hi - p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+    e += a.hi * b.lo + a.lo * b.hi;
+    product.hi = p + e;
+    product.lo = e - (product.hi - p);
+    return product;
+}
+
+dd_s dd_add_double(dd_s a, double b) {
+    dd_s d;
+
+    d.hi = b;
+    d.lo = 0.0;
+    return dd_add(a, d);
+}
+
+int compute_mandelbrot_dd(dd_s re, dd_s im, int iteration) {
+    int i;
+    dd_s r2, i2, t;
+    dd_s zR = re;
+    dd_s zI = im;
+
+    for (i = 0; i < iteration; ++i) {
+        r2 = dd_mul(zR, zR);
+        i2 = dd_mul(zI, zI);
+
+        if (r2.hi + i2.hi > 4.0) {
+            return i;
+        }
+
+        t = dd_mul(zR, zI);
+        t.hi *= 2.0;
+        t.lo *= 2.0;
+        zI = dd_add(t, im);
+        i2.hi = -i2.hi;
+        i2.lo = -i2.lo;
+        zR = dd_add(dd_add(r2, i2), re);
+    }
+
+    return iteration;
+}
+
+long to_fixed(double value, int shift) {
+    value *= (double)(1L << shift);
+    return (long)(value < 0 ? value - 0.5 : value + 0.5);
+}
+
+// the cheapest number type that resolves a pixel spacing of step in the view
+int pick_precision(double step) {
+    double re_extent, im_extent;
+    int p;
+
+    re_extent = (view.re.hi < 0 ? -view.re.hi : view.re.hi) + view.width / 2;
+    im_extent = (view.im.hi < 0 ? -view.im.hi : view.im.hi) + view.height / 2;
+    for (p = 0; p < PRECISION_DOUBLE_DOUBLE; p++) {
+        if ((p == PRECISION_FIXED16 || p == PRECISION_FIXED32)
+            && (re_extent > FIXED_RANGE || im_extent > FIXED_RANGE)) continue;
+        if (step >= precision_steps[p] * STEPS_PER_PIXEL) return p;
+    }
+    return PRECISION_DOUBLE_DOUBLE;
+}
+
+// map the view onto a width x height grid of pixels and pick a number type
+void set_grid(uint width, uint height) {
+    grid_dx = view.width / (width - 1);
+    grid_dy = view.height / (height - 1);
+    grid_remin = view.re.hi - view.width / 2;
+    grid_immax = view.im.hi + view.height / 2;
+    grid_dd_remin = dd_add_double(view.re, -view.width / 2);
+    grid_dd_immax = dd_add_double(view.im, view.height / 2);
+
+    grid_precision = precision;
+    if (grid_precision == PRECISION_AUTO) {
+        grid_precision = pick_precision(grid_dx < grid_dy ? grid_dx : grid_dy);
+    }
+
+#ifdef __DOS__
+    // the x87 rounds to 64 bits by default, which breaks the error terms
+    _control87(grid_precision == PRECISION_DOUBLE_DOUBLE ? PC_53 : PC_64, MCW_PC);
+#endif
+}
+
+// escape count of the pixel at x, y of the grid
+int escape_count(uint x, uint y) {
+    double re, im;
+
+    re = grid_remin + x * grid_dx;
+    im = grid_immax - y * grid_dy;
+    switch (grid_precision) {
+    case PRECISION_FIXED16:
+        return compute_mandelbrot_fixed16((short)to_fixed(re, FIXED16_SHIFT),
+            (short)to_fixed(im, FIXED16_SHIFT), MAX_ITERATIONS);
+    case PRECISION_FLOAT:
+        return compute_mandelbrot_float((float)re, (float)im, MAX_ITERATIONS);
+    case PRECISION_FIXED32:
+        return compute_mandelbrot_fixed32(to_fixed(re, FIXED32_SHIFT),
+            to_fixed(im, FIXED32_SHIFT), MAX_ITERATIONS);
+    case PRECISION_DOUBLE:
+        return compute_mandelbrot(re, im, MAX_ITERATIONS);
+    default:
+        return compute_mandelbrot_dd(dd_add_double(grid_dd_remin, x * grid_dx),
+            dd_add_double(grid_dd_immax, -(y * grid_dy)), MAX_ITERATIONS);
+    }
+}
+
+// palette index of the pixel at x, y of the grid: black inside the set,
+// otherwise by how fast it escapes
+byte pixel_color(uint x, uint y) {
+    int value;
+
+    PROF_BEGIN(PROF_COMPUTE_MANDELBROT);
+    value = escape_count(x, y);
+    PROF_END(PROF_COMPUTE_MANDELBROT);
+
+    if (value == MAX_ITERATIONS) return BLACK;
+    value = (value < 0) ? 0 : (value > 11) ? 11 : value;
+    return palette[value];
+}
+
+void draw_mandelbrot() {
+    uint x, y;
+
+    set_grid(screen_width, screen_height);
 
     wait_for_retrace();
 
-    for (y = 0; y < VGA_256_COLOR_SCREEN_HEIGHT; y++) {
-        im = immax - y * dy;
+    for (y = 0; y < screen_height; y++) {
+        for (x = 0; x < screen_width; x++) {
+            draw_pixel(x, y, pixel_color(x, y));
+        }
+
+        // one frame per row shows the picture being built
+        RECORD_FRAME();
 
-        for (x = 0; x < VGA_256_COLOR_SCREEN_WIDTH; x++) {
-            value = compute_mandelbrot(remin + x * dx, im, 100);
+        // a memory read while the keyboard handler is installed
+        if (interactive && kb_hit()) return;
+    }
+}
+
+// zoom the view around its center
+void zoom(double factor) {
+    view.width /= factor;
+    view.height /= factor;
+}
+
+// pan or zoom the view for a key; returns 0 for any other key
+int navigate(byte key) {
+    double re_step = view.width / PAN_STEP;
+    double im_step = view.height / PAN_STEP;
+
+    switch (key) {
+    case KEY_LEFT: re_step = -re_step;  // fall through
+    case KEY_RIGHT:
+        view.re = dd_add_double(view.re, re_step);
+        break;
+    case KEY_DOWN: im_step = -im_step;  // fall through
+    case KEY_UP:
+        view.im = dd_add_double(view.im, im_step);
+        break;
+    case KEY_EQUALS:
+    case KEY_PAD_PLUS:
+    case KEY_PAGE_UP:
+        zoom(ZOOM_STEP);
+        break;
+    case KEY_MINUS:
+    case KEY_PAD_MINUS:
+    case KEY_PAGE_DOWN:
+        zoom(1 / ZOOM_STEP);
+        break;
+    default:
+        return 0;
+    }
+    return 1;
+}
 
-            if (value == 100)
-                draw_pixel(x, y, BLACK);
-            else {
-                value = (value < 0) ? 0 : (value > 11) ? 11 : value;
-                draw_pixel(x, y, palette[value]);
+// render the view to a width x height PPM file without touching the screen
+//
+// Rows are colored a chunk at a time and flushed every BAND_ROWS rows, so
+// memory use does not grow with the image. The view is kept in a header
+// comment; when name already holds the start of the same image, rendering
+// resumes after its last complete band. A key press stops after the current
+// band. Returns 1 when the image is complete, 0 if it was stopped, and -1 if
+// the file is too large or a write fails, such as on a full disk; whatever
+// bands made it to the file are kept for a later resume.
+int render_ppm(char *name, uint width, uint height, byte progress) {
+    static byte rgb[VGA_256_COLOR_NUM_COLORS * 3];
+    static byte pixels[CHUNK_PIXELS * 3];
+    char header[MAX_HEADER], existing[MAX_HEADER];
+    FILE *file;
+    ulong row_bytes, size;
+    uint header_size, i, x, y, count;
+    byte *color;
+
+    row_bytes = (ulong)width * 3;
+    if (row_bytes * height > MAX_PPM_BYTES) return -1;
+
+    set_grid(width, height);
+    sprintf(header, "P6\n# mandel %.17g%+.17g %.17g%+.17g %.17g %.17g %d %s\n%u %u\n255\n",
+        view.re.hi, view.re.lo, view.im.hi, view.im.lo, view.width, view.height,
+        MAX_ITERATIONS, precision_names[grid_precision], width, height);
+    header_size = strlen(header);
+
+    // pick up where an earlier render of the same image stopped
+    y = 0;
+    file = fopen(name, "r+b");
+    if (file != NULL) {
+        if (fread(existing, 1, header_size, file) == header_size
+            && memcmp(existing, header, header_size) == 0) {
+            fseek(file, 0, SEEK_END);
+            size = ftell(file) - header_size;
+            y = (uint)((size / row_bytes < height) ? size / row_bytes : height);
+            y -= y % BAND_ROWS;
+        } else {
+            fclose(file);
+            file = NULL;
+        }
+    }
+    if (file == NULL) {
+        file = fopen(name, "wb");
+        if (file == NULL) return -1;
+        fwrite(header, 1, header_size, file);
+    }
+    if (fseek(file, (long)(header_size + y * row_bytes), SEEK_SET) != 0) {
+        fclose(file);
+        return -1;
+    }
+
+    // the mode 0x13 palette, 6 bits per component scaled to 8
+    vga_default_palette(rgb);
+    for (i = 0; i < sizeof(rgb); i++) {
+        rgb[i] = rgb[i] * 255 / 63;
+    }
+
+    for (; y < height; y++) {
+        for (x = 0; x < width; x += count) {
+            count = (width - x < CHUNK_PIXELS) ? width - x : CHUNK_PIXELS;
+            for (i = 0; i < count; i++) {
+                color = rgb + pixel_color(x + i, y) * 3;
+                pixels[i * 3 + 0] = color[0];
+                pixels[i * 3 + 1] = color[1];
+                pixels[i * 3 + 2] = color[2];
+            }
+            fwrite(pixels, 3, count, file);
+        }
+
+        if ((y + 1) % BAND_ROWS == 0 || y + 1 == height) {
+            if (fflush(file) != 0 || ferror(file)) {
+                fclose(file);
+                if (progress) printf("\n");
+                return -1;
+            }
+        }
+
+        if ((y + 1) % BAND_ROWS == 0 && y + 1 < height) {
+            if (progress) printf("\r%u of %u rows", y + 1, height);
+            if (kbhit()) {
+                getch();
+                fclose(file);
+                if (progress) printf("\n");
+                return 0;
             }
         }
     }
+
+    if (fclose(file) != 0) return -1;
+    if (progress) printf("\r%u of %u rows\n", height, height);
+    return 1;
 }
 
 int main(int argc, char *argv[]) {
-    set_mode(VGA_256_COLOR_MODE);
+    uint width = VGA_256_COLOR_SCREEN_WIDTH;
+    uint height = VGA_256_COLOR_SCREEN_HEIGHT;
+    ulong size[2];
+    byte help, ppm;
+    int i, status;
+
+    ppm = (argc > 1 && strcmp(argv[1], "ppm") == 0);
+    if (ppm) {
+        help = (argc != 5 && argc != 9);
+        for (i = 0; !help && i < 2; i++) {
+            size[i] = strtoul(argv[3 + i], NULL, 10);
+            help = (size[i] < 2 || size[i] > 0xFFFF);
+        }
+        if (!help) {
+            width = (uint)size[0];
+            height = (uint)size[1];
+        }
+        if (!help && argc == 9) {
+            view.re.hi = (atof(argv[5]) + atof(argv[6])) / 2;
+            view.im.hi = (atof(argv[7]) + atof(argv[8])) / 2;
+            view.width = atof(argv[6]) - atof(argv[5]);
+            view.height = atof(argv[8]) - atof(argv[7]);
+            help = !(view.width > 0 && view.height > 0);
+        }
+    } else {
+        help = (argc > 2 || (argc == 2 && !parse_resolution(argv[1], &width, &height)));
+    }
+
+    if (help) {
+        printf("Usage: %s [lo|640|800|1024]\n", argv[0]);
+        printf("       %s ppm FILE WIDTH HEIGHT [REMIN REMAX IMMIN IMMAX]\n", argv[0]);
+        printf("Where:\n");
+        printf("  lo   - VGA 256 color mode (320x200), the default\n");
+        printf("  640  - VESA VBE 256 color mode (640x480)\n");
+        printf("  800  - VESA VBE 256 color mode (800x600)\n");
+        printf("  1024 - VESA VBE 256 color mode (1024x768)\n");
+        printf("  ppm  - render to a PPM file instead of the screen, by default\n");
+        printf("         from -2 to 1 and -1 to 1; a key press stops it and the\n");
+        printf("         same command resumes it; REMIN must be below REMAX and\n");
+        printf("         IMMIN below IMMAX\n");
+        printf("Keys:\n");
+        printf("  Arrows - pan\n");
+        printf("  +/-    - zoom in and out\n");
+        printf("  Any other key quits\n");
+        return EXIT_FAILURE;
+    }
+
+    PROF_INIT();
+
+    if (ppm) {
+        status = render_ppm(argv[2], width, height, 1);
+        if (status < 0) {
+            printf("Can not write a %ux%u image to %s\n", width, height, argv[2]);
+            return EXIT_FAILURE;
+        }
+        if (status == 0) printf("Stopped, run the same command again to resume\n");
+        return EXIT_SUCCESS;
+    }
+
+    if (!set_resolution(width, height)) {
+        printf("No VESA VBE 256 color mode at %ux%u\n", width, height);
+        return EXIT_FAILURE;
+    }
+
+    kb_init();
+    interactive = 1;
+
+    RECORD_OPEN("MANDEL.FLC");
 
-    draw_mandelbrot();
+    do {
+        draw_mandelbrot();
+        PROF_OVERLAY();
+    } while (navigate(kb_wait()));
 
-    getch();
+    RECORD_CLOSE();
 
     set_mode(TEXT_MODE);
 
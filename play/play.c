@@ -0,0 +1,280 @@
+/**
+ * Play
+ *
+ * Play an FLC animation recorded by the graphics programs (make RECORD=1).
+ *
+ * Frames are read into a buffer and decoded straight to video memory: runs
+ * and literals become fill_span() and copy_span() calls, so the work per
+ * pixel is a memset or memcpy.
+ */
+
+#include <stdio.h>                      // printf fopen fread fseek
+#include <stdlib.h>                     // EXIT_SUCCESS EXIT_FAILURE
+#include <string.h>                     // memmove strcmp
+#include <time.h>                       // clock
+#include "vga.h"                        // set_resolution copy_span fill_span wait kbhit getch
+#include "record.h"                     // flc_header_s flc_frame_s flc_chunk_s
+
+#define PLAY_BUFFER_SIZE 16384          // file read buffer
+#define MAX_PACKET_SIZE (2 + 2 * FLC_MAX_PACKET) // longest packet, with skip and palette
+
+FILE *flc;                              // animation being played
+flc_header_s flc_header;
+byte play_buffer[PLAY_BUFFER_SIZE];
+uint play_pos, play_end;                // unread bytes in play_buffer
+ulong play_offset;                      // file offset of play_buffer[0]
+
+// make at least count bytes readable at play_buffer + play_pos; returns 0
+// if the file ends first
+int play_fill(uint count) {
+    if (play_end - play_pos >= count) return 1;
+    memmove(play_buffer, play_buffer + play_pos, play_end - play_pos);
+    play_offset += play_pos;
+    play_end -= play_pos;
+    play_pos = 0;
+    play_end += fread(play_buffer + play_end, 1, PLAY_BUFFER_SIZE - play_end, flc);
+    return play_end >= count;
+}
+
+byte play_byte(void) {
+    return play_buffer[play_pos++];
+}
+
+ushort play_word(void) {
+    ushort value;
+
+    value = play_buffer[play_pos] | (play_buffer[play_pos + 1] << 8);
+    play_pos += 2;
+    return value;
+}
+
+ulong play_dword(void) {
+    ulong value;
+
+    value = play_word();
+    return value | ((ulong)play_word() << 16);
+}
+
+// continue reading at a file offset
+void play_seek(ulong offset) {
+    if (offset >= play_offset && offset <= play_offset + play_end) {
+        play_pos = (uint)(offset - play_offset);
+        return;
+    }
+    fseek(flc, offset, SEEK_SET);
+    play_offset = offset;
+    play_pos = 0;
+    play_end = 0;
+}
+
+// palette packets; shift is 2 for 8 bit components, 0 for 6 bit ones
+void play_palette(byte shift) {
+    ushort packets;
+    uint index, count;
+
+    play_fill(2);
+    index = 0;
+    for (packets = play_word(); packets > 0; packets--) {
+        play_fill(2);
+        index += play_byte();
+        count = play_byte();
+        if (count == 0) count = VGA_256_COLOR_NUM_COLORS;
+        if (index + count > VGA_256_COLOR_NUM_COLORS) return;
+        outp(PALETTE_INDEX, index);
+        for (index += count, count *= 3; count > 0; count--) {
+            if (!play_fill(1)) return;
+            outp(PALETTE_DATA, play_byte() >> shift);
+        }
+    }
+}
+
+// whole screen: a run has a positive size, a literal a negative one
+void play_byte_run(void) {
+    uint x, y, count;
+    signed char size;
+
+    for (y = 0; y < flc_header.height; y++) {
+        play_fill(1);
+        play_pos++;                     // packet count, not used
+        for (x = 0; x < flc_header.width; x += count) {
+            if (!play_fill(MAX_PACKET_SIZE) && play_end - play_pos < 2) return;
+            size = (signed char)play_byte();
+            if (size >= 0) {
+                count = size;
+                if (x + count > flc_header.width) return;
+                fill_span(x, y, play_byte(), count);
+            } else {
+                count = -size;
+                if (x + count > flc_header.width) return;
+                copy_span(x, y, play_buffer + play_pos, count);
+                play_pos += count;
+            }
+        }
+    }
+}
+
+// changed lines: each packet skips pixels, then a literal has a positive
+// size and a run a negative one
+void play_lc(void) {
+    uint x, y, end, count, packets;
+    signed char size;
+
+    play_fill(4);
+    y = play_word();
+    end = y + play_word();
+    if (end > flc_header.height) return;
+    for (; y < end; y++) {
+        play_fill(1);
+        x = 0;
+        for (packets = play_byte(); packets > 0; packets--) {
+            if (!play_fill(MAX_PACKET_SIZE) && play_end - play_pos < 2) return;
+            x += play_byte();
+            size = (signed char)play_byte();
+            if (size >= 0) {
+                count = size;
+                if (x + count > flc_header.width) return;
+                copy_span(x, y, play_buffer + play_pos, count);
+                play_pos += count;
+            } else {
+                count = -size;
+                if (x + count > flc_header.width) return;
+                fill_span(x, y, play_byte(), count);
+            }
+            x += count;
+        }
+    }
+}
+
+// whole screen, uncompressed
+void play_copy(void) {
+    uint y;
+
+    for (y = 0; y < flc_header.height; y++) {
+        if (!play_fill(flc_header.width)) return;
+        copy_span(0, y, play_buffer + play_pos, flc_header.width);
+        play_pos += flc_header.width;
+    }
+}
+
+void play_black(void) {
+    uint y;
+
+    for (y = 0; y < flc_header.height; y++) {
+        fill_span(0, y, 0, flc_header.width);
+    }
+}
+
+// draw the next frame; returns 0 at the end of the animation
+int play_frame(void) {
+    ulong frame_start, frame_size, chunk_start, chunk_size;
+    ushort type, chunks;
+
+    do {
+        frame_start = play_offset + play_pos;
+        if (!play_fill(sizeof(flc_frame_s))) return 0;
+        frame_size = play_dword();
+        type = play_word();
+        chunks = play_word();
+        play_pos += sizeof(flc_frame_s) - 8;
+        if (frame_size < sizeof(flc_frame_s)) return 0;
+        // skip prefix and other chunks that are not frames
+        if (type != FLC_FRAME) play_seek(frame_start + frame_size);
+    } while (type != FLC_FRAME);
+
+    for (; chunks > 0; chunks--) {
+        chunk_start = play_offset + play_pos;
+        if (!play_fill(sizeof(flc_chunk_s))) return 0;
+        chunk_size = play_dword();
+        type = play_word();
+        switch (type) {
+        case FLC_COLOR_256: play_palette(2); break;
+        case FLC_COLOR_64: play_palette(0); break;
+        case FLC_LC: play_lc(); break;
+        case FLC_BLACK: play_black(); break;
+        case FLC_BYTE_RUN: play_byte_run(); break;
+        case FLC_COPY: play_copy(); break;
+        }
+        play_seek(chunk_start + chunk_size);
+    }
+    play_seek(frame_start + frame_size);
+    return 1;
+}
+
+// open an animation and go to its first frame; returns 0 if it is not one
+int play_open(char *name) {
+    flc = fopen(name, "rb");
+    if (flc == NULL) return 0;
+    if (fread(&flc_header, sizeof(flc_header), 1, flc) != 1
+        || (flc_header.magic != FLC_MAGIC && flc_header.magic != FLI_MAGIC)) {
+        fclose(flc);
+        flc = NULL;
+        return 0;
+    }
+    if (flc_header.magic == FLI_MAGIC) {
+        flc_header.frame1 = sizeof(flc_header);
+        flc_header.speed = flc_header.speed * 1000 / 70;
+    }
+    play_offset = 0;
+    play_pos = 0;
+    play_end = 0;
+    play_seek(flc_header.frame1);
+    return 1;
+}
+
+void play_close(void) {
+    fclose(flc);
+    flc = NULL;
+}
+
+int main(int argc, char *argv[]) {
+    ulong frames = 0;
+    ushort retraces;
+    clock_t start;
+    byte fast;
+    double seconds;
+
+    fast = (argc == 3 && strcmp(argv[2], "fast") == 0);
+    if (argc < 2 || argc > 3 || (argc == 3 && !fast)) {
+        printf("Usage: %s FILE.FLC [fast]\n", argv[0]);
+        printf("Where:\n");
+        printf("  fast - play without waiting for retrace and report the frame rate\n");
+        printf("Plays in a loop until a key is pressed.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!play_open(argv[1])) {
+        printf("%s is not an FLC file\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (!set_resolution(flc_header.width, flc_header.height)) {
+        printf("No VESA VBE 256 color mode at %ux%u\n", flc_header.width, flc_header.height);
+        play_close();
+        return EXIT_FAILURE;
+    }
+
+    // wait as many retraces as the recording took per frame
+    retraces = (ushort)((flc_header.speed + FLC_FRAME_MS / 2) / FLC_FRAME_MS);
+    if (retraces == 0) retraces = 1;
+
+    start = clock();
+    while (!kbhit()) {
+        if (!fast) wait(retraces);
+        if (play_frame()) {
+            frames++;
+        } else {
+            play_seek(flc_header.frame1);
+        }
+    }
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    getch();
+
+    set_mode(TEXT_MODE);
+    play_close();
+
+    if (fast && seconds > 0) {
+        printf("%lu frames in %.2f seconds, %.1f frames per second\n", frames, seconds, frames / seconds);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -4,30 +4,15 @@
  * Draw QIX lines with alternating colors.
  */
 
-#include <conio.h>                      // clrscr getch kbhit
-#include <dos.h>                        // int86 outp inp
 #include <math.h>                       // sin
 #include <stdio.h>                      // printf sprintf
 #include <stdlib.h>                     // EXIT_SUCCESS EXIT_FAILURE malloc
 #include <string.h>
+#include "vga.h"                        // set_mode draw_pixel wait_for_retrace
+#include "prof.h"                       // PROF_BEGIN PROF_END
+#include "record.h"                     // RECORD_OPEN RECORD_PALETTE RECORD_CLOSE
+#include "keyboard.h"                   // kb_init kb_hit kb_read KB_HELD
 
-#define VIDEO_INT 0x10                  // BIOS video interrupt
-#define SET_MODE 0x00                   // BIOS function to set video mode
-#define VGA_16_COLOR_MODE 0x12          // use to set 16 color VGA mode
-#define VGA_256_COLOR_MODE 0x13         // use to set 256 color VGA mode
-#define TEXT_MODE 0x03                  // use to set text mode
-#define PIXEL_PLOT 0x0C                 // BIOS function to plot a pixel
-#define VIDEO_MEMORY 0xA0000000L        // start of video memory
-#define VGA_16_COLOR_SCREEN_WIDTH 640   // width in pixels of VGA mode 0x12
-#define VGA_16_COLOR_SCREEN_HEIGHT 480  // height in pixels of VGA mode 0x12
-#define VGA_16_COLOR_NUM_COLORS 16      // number of colors in VGA mode 0x12
-#define VGA_256_COLOR_SCREEN_WIDTH 320  // width in pixels of VGA mode 0x13
-#define VGA_256_COLOR_SCREEN_HEIGHT 200 // height in pixels of VGA mode 0x13
-#define VGA_256_COLOR_NUM_COLORS 256    // number of colors in VGA mode 0x13
-#define PALETTE_INDEX 0x3C8             // use to reset palette index
-#define PALETTE_DATA 0x3C9              // use to write colors to palette
-#define INPUT_STATUS 0x3DA              // vga status register
-#define VRTRACE_BIT 0x08                // 1 = vertical retrace, ram access ok for 1.25ms
 #define PI 3.14159265359                // PI
 
 #define COLOR_BG 0                      // default background color
@@ -36,9 +21,9 @@
 #define HISTORY_SIZE 10                 // how many lines to display at once
 #define STEP 8                          // line spacing
 #define STEP_RANGE 6                    // spacing plus/minus range
-
-typedef unsigned char byte;
-typedef unsigned short ushort;
+#define DEFAULT_DELAY 3                 // retraces per frame
+#define MIN_DELAY 1                     // fastest speed
+#define MAX_DELAY 30                    // slowest speed
 
 typedef struct {
     short x1;
@@ -51,41 +36,24 @@ typedef struct {
 typedef struct {
     byte help;
     byte vga_mode;
+    uint width;                         // size of a 256 color mode
+    uint height;
 } args_s;
 
-byte far *vga = (byte far *)VIDEO_MEMORY;
-byte vga_mode, *palette;
-ushort screen_width, screen_height, num_colors;
-
-void wait_for_retrace() {
-    while(inp(INPUT_STATUS) & VRTRACE_BIT);
-    while(!(inp(INPUT_STATUS) & VRTRACE_BIT));
-}
-
-void wait(ushort time) {
-    ushort i;
-
-    for (i = 0; i < time; i++) {
-        wait_for_retrace();
-    }
-}
-
-void set_mode(byte mode) {
-    union REGS regs;
-
-    regs.h.ah = SET_MODE;
-    regs.h.al = mode;
-    int86(VIDEO_INT, &regs, &regs);
-}
+byte *palette;
 
 void set_black_palette() {
     ushort i;
 
+    PROF_BEGIN(PROF_SET_PALETTE);
     outp(PALETTE_INDEX, 0);
     for (i = 0; i < num_colors * 3; i++) {
         palette[i] = 0;
         outp(PALETTE_DATA, 0);
     }
+    PROF_COUNT(PROF_PORT_IO, num_colors * 3 + 1);
+    PROF_END(PROF_SET_PALETTE);
+    RECORD_PALETTE(palette, num_colors);
 }
 
 void set_palette(byte index, byte r, byte g, byte b) {
@@ -95,14 +63,18 @@ void set_palette(byte index, byte r, byte g, byte b) {
     palette[index * 3 + 1] = g;
     palette[index * 3 + 2] = b;
 
+    PROF_BEGIN(PROF_SET_PALETTE);
     outp(PALETTE_INDEX, 0);
     for (i = 0; i < num_colors * 3; i++) {
         outp(PALETTE_DATA, palette[i]);
     }
+    PROF_COUNT(PROF_PORT_IO, num_colors * 3 + 1);
+    PROF_END(PROF_SET_PALETTE);
+    RECORD_PALETTE(palette, num_colors);
 }
 
 byte random_color() {
-    if (vga_mode == VGA_256_COLOR_MODE) {
+    if (num_colors == VGA_256_COLOR_NUM_COLORS) {
         return rand() % num_colors;
     } else {
         // use all colors except black (0)
@@ -114,7 +86,7 @@ byte random_neighbor_color() {
     static byte index = 0;
     byte prev_r, prev_g, prev_b, r, g, b;
 
-    if (vga_mode != VGA_256_COLOR_MODE) {
+    if (num_colors != VGA_256_COLOR_NUM_COLORS) {
         return random_color();
     }
 
@@ -143,16 +115,8 @@ void line_copy(line_s *target_line, line_s *source_line) {
     target_line->color = source_line->color;
 }
 
-void draw_pixel(ushort x, ushort y, byte color) {
-    ushort offset;
-
-    offset = y * screen_width + x;      // slower, but easy to understand
-    //offset = (y<<8) + (y<<6) + x;       // faster, but harder to understand
-    vga[offset] = color;
-}
-
 void draw_line(line_s *line) {
-    ushort x1, y1, x2, y2, x, y;
+    uint x1, y1, x2, y2, x, y;
     byte color;
     int dx, dy, sx, sy, e1, e2;
 
@@ -170,6 +134,8 @@ void draw_line(line_s *line) {
     sy = (y1 < y2) ? 1 : -1;
     e1 = dx + dy;
 
+    PROF_BEGIN(PROF_DRAW_LINE);
+
     x = x1;
     y = y1;
 
@@ -190,6 +156,8 @@ void draw_line(line_s *line) {
             y += sy;
         }
     }
+
+    PROF_END(PROF_DRAW_LINE);
 }
 
 ushort next_degree(ushort degree) {
@@ -223,7 +191,7 @@ void next_line(line_s *line, line_s *line_delta, line_s *line_degree) {
         line->x1 = 0 - line->x1;
         line_delta->x1 = -line_delta->x1;
     }
-    if (line->x1 >= screen_width) {
+    if (line->x1 >= (short)screen_width) {
         line->x1 = screen_width - (line->x1 - screen_width);
         line_delta->x1 = -line_delta->x1;
     }
@@ -231,7 +199,7 @@ void next_line(line_s *line, line_s *line_delta, line_s *line_degree) {
         line->y1 = 0 - line->y1;
         line_delta->y1 = -line_delta->y1;
     }
-    if (line->y1 >= screen_height) {
+    if (line->y1 >= (short)screen_height) {
         line->y1 = screen_height - (line->y1 - screen_height);
         line_delta->y1 = -line_delta->y1;
     }
@@ -239,7 +207,7 @@ void next_line(line_s *line, line_s *line_delta, line_s *line_degree) {
         line->x2 = 0 - line->x2;
         line_delta->x2 = -line_delta->x2;
     }
-    if (line->x2 >= screen_width) {
+    if (line->x2 >= (short)screen_width) {
         line->x2 = screen_width - (line->x2 - screen_width);
         line_delta->x2 = -line_delta->x2;
     }
@@ -247,16 +215,17 @@ void next_line(line_s *line, line_s *line_delta, line_s *line_degree) {
         line->y2 = 0 - line->y2;
         line_delta->y2 = -line_delta->y2;
     }
-    if (line->y2 >= screen_height) {
+    if (line->y2 >= (short)screen_height) {
         line->y2 = screen_height - (line->y2 - screen_height);
         line_delta->y2 = -line_delta->y2;
     }
 }
 
-// draw lines until a key is pressed
+// draw lines until a key other than a speed key is pressed
 void draw_lines() {
     line_s line, line_delta, line_degree, line_history[HISTORY_SIZE];
-    ushort i, history_index;
+    ushort i, history_index, delay;
+    byte key;
 
     // randomize starting values
     line.x1 = rand() % screen_width;
@@ -281,10 +250,26 @@ void draw_lines() {
     }
     history_index = 0;
 
+    delay = DEFAULT_DELAY;
+
     // loop until key-press
-    while (!kbhit()) {
+    for (;;) {
+        if (kb_hit()) {
+            key = kb_read();
+            if (key == KEY_UP || key == KEY_EQUALS || key == KEY_PAD_PLUS) {
+                if (delay > MIN_DELAY) delay--;
+            } else if (key == KEY_DOWN || key == KEY_MINUS || key == KEY_PAD_MINUS) {
+                if (delay < MAX_DELAY) delay++;
+            } else if (key != KEY_SPACE) {
+                break;
+            }
+        }
+
         //wait_for_retrace();
-        wait(3);
+        wait(delay);
+
+        // hold space to pause
+        if (KB_HELD(KEY_SPACE)) continue;
 
         // draw next line
         next_line(&line, &line_delta, &line_degree);
@@ -298,8 +283,6 @@ void draw_lines() {
         line_copy(&line_history[history_index++], &line);
         if (history_index >= HISTORY_SIZE) history_index = 0;
     }
-
-    getch();
 }
 
 void parse_args(int argc, char *argv[], args_s *args) {
@@ -307,12 +290,14 @@ void parse_args(int argc, char *argv[], args_s *args) {
 
     args->help = 0;
     args->vga_mode = VGA_256_COLOR_MODE;
+    args->width = VGA_256_COLOR_SCREEN_WIDTH;
+    args->height = VGA_256_COLOR_SCREEN_HEIGHT;
 
     for (i = 1; i < argc; i++) {
-        if (strcmp(argv[i], "lo") == 0) {
-            args->vga_mode = VGA_256_COLOR_MODE;
-        } else if (strcmp(argv[i], "hi") == 0) {
+        if (strcmp(argv[i], "hi") == 0) {
             args->vga_mode = VGA_16_COLOR_MODE;
+        } else if (parse_resolution(argv[i], &args->width, &args->height)) {
+            args->vga_mode = VGA_256_COLOR_MODE;
         } else {
             args->help = 1;
         }
@@ -325,32 +310,42 @@ int main(int argc, char *argv[]) {
     parse_args(argc, argv, &args);
 
     if (args.help) {
-        printf("Usage: %s [lo|hi]\n", argv[0]);
+        printf("Usage: %s [lo|hi|640|800|1024]\n", argv[0]);
         printf("Where:\n");
-        printf("  lo - VGA 256 color mode (320x200)\n");
-        printf("  hi - VGA 16 color mode (640x480)\n");
+        printf("  lo   - VGA 256 color mode (320x200)\n");
+        printf("  hi   - VGA 16 color mode (640x480)\n");
+        printf("  640  - VESA VBE 256 color mode (640x480)\n");
+        printf("  800  - VESA VBE 256 color mode (800x600)\n");
+        printf("  1024 - VESA VBE 256 color mode (1024x768)\n");
+        printf("Keys:\n");
+        printf("  Up/+   - faster\n");
+        printf("  Down/- - slower\n");
+        printf("  Space  - hold to pause\n");
+        printf("  Any other key quits\n");
         return EXIT_FAILURE;
     }
 
-    vga_mode = args.vga_mode;
-    if (vga_mode == VGA_256_COLOR_MODE) {
-        screen_width = VGA_256_COLOR_SCREEN_WIDTH;
-        screen_height = VGA_256_COLOR_SCREEN_HEIGHT;
-        num_colors = VGA_256_COLOR_NUM_COLORS;
-    } else {
-        screen_width = VGA_16_COLOR_SCREEN_WIDTH;
-        screen_height = VGA_16_COLOR_SCREEN_HEIGHT;
-        num_colors = VGA_16_COLOR_NUM_COLORS;
-    }
+    PROF_INIT();
 
-    set_mode(vga_mode);
+    if (args.vga_mode == VGA_16_COLOR_MODE) {
+        set_mode(args.vga_mode);
+    } else if (!set_resolution(args.width, args.height)) {
+        printf("No VESA VBE 256 color mode at %ux%u\n", args.width, args.height);
+        return EXIT_FAILURE;
+    }
 
     palette = malloc(VGA_256_COLOR_NUM_COLORS * 3 * sizeof(byte));
 
+    kb_init();
+
+    RECORD_OPEN("QIXLINES.FLC");
+
     set_black_palette();
 
     draw_lines();
 
+    RECORD_CLOSE();
+
     set_mode(TEXT_MODE);
 
     return EXIT_SUCCESS;
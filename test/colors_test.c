@@ -0,0 +1,24 @@
+/**
+ * Colors Test
+ *
+ * draw_colors() with the 16 by 16 grid of all 256 colors.
+ */
+
+#define main colors_main
+#include "../colors/colors.c"
+#undef main
+
+#include "test.h"
+
+void render(void) {
+    set_mode(VGA_256_COLOR_MODE);
+    draw_colors(
+        VGA_256_COLOR_SCREEN_WIDTH,
+        VGA_256_COLOR_SCREEN_HEIGHT,
+        VGA_256_COLOR_NUM_COLORS,
+        16, 16);
+}
+
+int main(int argc, char *argv[]) {
+    return test_run("colors", render, argc, argv);
+}
@@ -0,0 +1,20 @@
+/**
+ * Lines Test
+ *
+ * draw_lines() sweeping lines from the top left corner.
+ */
+
+#define main lines_main
+#include "../lines/lines.c"
+#undef main
+
+#include "test.h"
+
+void render(void) {
+    set_mode(VGA_256_COLOR_MODE);
+    draw_lines();
+}
+
+int main(int argc, char *argv[]) {
+    return test_run("lines", render, argc, argv);
+}
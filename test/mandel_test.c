@@ -0,0 +1,118 @@
+/**
+ * Mandelbrot Test
+ *
+ * draw_mandelbrot() at its default view, in mode 0x13 and at the 640x480 VBE
+ * resolution, and render_ppm() of the same view stopped partway, resumed,
+ * and compared with the screen. The default view again with each number
+ * type forced, and a view too deep for double that must pick double-double.
+ */
+
+#define main mandel_main
+#include "../mandel/mandel.c"
+#undef main
+
+#include "test.h"
+
+#define PPM_FILE "mandel_band.ppm"
+#define PPM_BANDS 4                     // bands rendered before the "key press"
+#define DEEP_RE -2.0                    // the tip of the set, where points escape
+#define DEEP_WIDTH 3e-14                // quickly at any depth
+
+void render(void) {
+    set_mode(VGA_256_COLOR_MODE);
+    draw_mandelbrot();
+}
+
+void render_640(void) {
+    set_resolution(640, 480);
+    draw_mandelbrot();
+}
+
+void render_precision(int forced) {
+    precision = forced;
+    render();
+    precision = PRECISION_AUTO;
+}
+
+void render_float(void) {
+    render_precision(PRECISION_FLOAT);
+}
+
+void render_fixed32(void) {
+    render_precision(PRECISION_FIXED32);
+}
+
+void render_double(void) {
+    render_precision(PRECISION_DOUBLE);
+}
+
+void render_double_double(void) {
+    render_precision(PRECISION_DOUBLE_DOUBLE);
+}
+
+// the screen is cleared if auto did not pick double-double
+void render_deep(void) {
+    view_s saved = view;
+
+    view.re.hi = DEEP_RE;
+    view.im.hi = 0.0;
+    view.width = DEEP_WIDTH;
+    view.height = DEEP_WIDTH * 2 / 3;
+    render();
+    if (grid_precision != PRECISION_DOUBLE_DOUBLE) {
+        memset(vga, 0, screen_width * screen_height);
+    }
+    view = saved;
+}
+
+// the screen is cleared if the file does not hold the same picture
+void render_ppm_resumed(void) {
+    char line[MAX_HEADER];
+    FILE *file;
+    ulong i;
+    byte *rgb, pixel[3];
+    int stopped, finished;
+
+    set_mode(VGA_256_COLOR_MODE);
+    draw_mandelbrot();
+
+    remove(PPM_FILE);
+    test_key_polls = PPM_BANDS - 1;
+    stopped = render_ppm(PPM_FILE, screen_width, screen_height, 0);
+    test_key_polls = screen_height;
+    finished = render_ppm(PPM_FILE, screen_width, screen_height, 0);
+
+    file = fopen(PPM_FILE, "rb");
+    if (stopped != 0 || finished != 1 || file == NULL) {
+        memset(vga, 0, screen_width * screen_height);
+        if (file != NULL) fclose(file);
+        return;
+    }
+    // skip the magic number, comment, size, and maximum lines
+    for (i = 0; i < 4; i++) {
+        if (fgets(line, sizeof(line), file) == NULL) break;
+    }
+    for (i = 0; i < (ulong)screen_width * screen_height; i++) {
+        rgb = vga_palette + vga[i] * 3;
+        if (fread(pixel, 3, 1, file) != 1 || pixel[0] != rgb[0] * 255 / 63
+            || pixel[1] != rgb[1] * 255 / 63 || pixel[2] != rgb[2] * 255 / 63) {
+            memset(vga, 0, screen_width * screen_height);
+            break;
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+    int rc;
+
+    rc = test_run("mandel", render, argc, argv);
+    if (test_run("mandel640", render_640, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandelppm", render_ppm_resumed, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandelflt", render_float, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandelfx32", render_fixed32, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandeldbl", render_double, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandeldd", render_double_double, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    if (test_run("mandeldeep", render_deep, argc, argv) != EXIT_SUCCESS) rc = EXIT_FAILURE;
+    return rc;
+}
@@ -0,0 +1,42 @@
+/**
+ * Play Test
+ *
+ * Record the qixlines test run, then play the file back over a cleared
+ * screen; the last frame must match the qixlines golden image.
+ */
+
+#define main qixlines_main
+#include "../qixlines/qixlines.c"
+#undef main
+
+#define main play_main
+#include "../play/play.c"
+#undef main
+
+#include "test.h"
+
+#define SEED 1984                       // random seed, as in qixlines_test.c
+#define FRAMES 500                      // frames drawn before the "key press"
+#define FLC_FILE "play_test.flc"
+
+void render(void) {
+    set_mode(VGA_256_COLOR_MODE);
+    srand(SEED);
+    if (palette == NULL) {
+        palette = malloc(VGA_256_COLOR_NUM_COLORS * 3 * sizeof(byte));
+    }
+    record_open(FLC_FILE);
+    set_black_palette();
+    test_key_polls = FRAMES;
+    draw_lines();
+    record_close();
+
+    set_mode(VGA_256_COLOR_MODE);
+    if (!play_open(FLC_FILE)) return;
+    while (play_frame());
+    play_close();
+}
+
+int main(int argc, char *argv[]) {
+    return test_run("play", render, argc, argv);
+}
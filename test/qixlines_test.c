@@ -0,0 +1,30 @@
+/**
+ * QIX Lines Test
+ *
+ * draw_lines() for a fixed number of frames from a fixed random seed,
+ * including the palette it cycles.
+ */
+
+#define main qixlines_main
+#include "../qixlines/qixlines.c"
+#undef main
+
+#include "test.h"
+
+#define SEED 1984                       // random seed
+#define FRAMES 500                      // frames drawn before the "key press"
+
+void render(void) {
+    set_mode(VGA_256_COLOR_MODE);
+    srand(SEED);
+    if (palette == NULL) {
+        palette = malloc(VGA_256_COLOR_NUM_COLORS * 3 * sizeof(byte));
+    }
+    set_black_palette();
+    test_key_polls = FRAMES;
+    draw_lines();
+}
+
+int main(int argc, char *argv[]) {
+    return test_run("qixlines", render, argc, argv);
+}
@@ -0,0 +1,208 @@
+/**
+ * Test
+ *
+ * Golden image and performance checks for the graphics programs.
+ *
+ * Golden checksums live in golden.txt and are kept in git; only "make bless"
+ * writes them, and a test without one fails. Timing baselines live in
+ * perf.txt, which is machine specific; it is written by the first run (or by
+ * "make bless") and later runs fail when a render gets slower than the
+ * baseline by more than PERF_THRESHOLD percent (default 25).
+ */
+
+#include <stdio.h>                      // fopen fgets fprintf sscanf
+#include <stdlib.h>                     // atof getenv EXIT_SUCCESS EXIT_FAILURE
+#include <string.h>                     // strcmp strlen
+#include <time.h>                       // clock_gettime
+#include "vga.h"
+#include "test.h"
+
+#define GOLDEN_FILE "golden.txt"        // name and crc32 per test
+#define PERF_FILE "perf.txt"            // name and milliseconds per render per test
+#define DEFAULT_THRESHOLD 25.0          // allowed slowdown in percent
+#define BATCHES 5                       // timing batches, the fastest one counts
+#define BATCH_SECONDS 0.05              // minimum length of a timing batch
+#define MAX_LINES 64                    // lines kept when rewriting a file
+#define LINE_SIZE 80
+
+int test_key_polls;
+
+int kbhit(void) {
+    if (test_key_polls > 0) {
+        test_key_polls--;
+        return 0;
+    }
+    return 1;
+}
+
+int getch(void) {
+    return 0;
+}
+
+ulong crc32_update(ulong crc, byte *data, ulong length) {
+    ulong i;
+    byte bit;
+
+    for (i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
+ulong screen_crc32(void) {
+    ulong crc = 0xFFFFFFFFUL;
+
+    crc = crc32_update(crc, vga, (ulong)screen_width * screen_height);
+    crc = crc32_update(crc, vga_palette, sizeof(vga_palette));
+    return crc ^ 0xFFFFFFFFUL;
+}
+
+// write the screen as NAME.ppm so a failed render can be looked at
+void write_ppm(char *name) {
+    char file_name[LINE_SIZE];
+    FILE *file;
+    ulong i;
+    byte *rgb;
+
+    sprintf(file_name, "%s.ppm", name);
+    file = fopen(file_name, "wb");
+    if (file == NULL) return;
+    fprintf(file, "P6\n%u %u\n255\n", screen_width, screen_height);
+    for (i = 0; i < (ulong)screen_width * screen_height; i++) {
+        rgb = vga_palette + vga[i] * 3;
+        fputc(rgb[0] * 255 / 63, file);
+        fputc(rgb[1] * 255 / 63, file);
+        fputc(rgb[2] * 255 / 63, file);
+    }
+    fclose(file);
+}
+
+// find "name value" in file_name; returns 1 and copies value if found
+int file_lookup(char *file_name, char *name, char *value) {
+    char line[LINE_SIZE], key[LINE_SIZE];
+    FILE *file;
+    int found = 0;
+
+    file = fopen(file_name, "r");
+    if (file == NULL) return 0;
+    while (!found && fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%79s %79s", key, value) == 2 && strcmp(key, name) == 0) {
+            found = 1;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// add or replace "name value" in file_name, keeping the other lines in order
+void file_store(char *file_name, char *name, char *value) {
+    char lines[MAX_LINES][LINE_SIZE], key[LINE_SIZE];
+    FILE *file;
+    int count = 0, i, replaced = 0;
+
+    file = fopen(file_name, "r");
+    if (file != NULL) {
+        while (count < MAX_LINES && fgets(lines[count], LINE_SIZE, file) != NULL) {
+            count++;
+        }
+        fclose(file);
+    }
+    for (i = 0; i < count; i++) {
+        if (sscanf(lines[i], "%79s", key) == 1 && strcmp(key, name) == 0) {
+            sprintf(lines[i], "%s %s\n", name, value);
+            replaced = 1;
+        }
+    }
+    if (!replaced && count < MAX_LINES) {
+        sprintf(lines[count++], "%s %s\n", name, value);
+    }
+
+    file = fopen(file_name, "w");
+    if (file == NULL) return;
+    for (i = 0; i < count; i++) {
+        fputs(lines[i], file);
+    }
+    fclose(file);
+}
+
+double seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// milliseconds per render, from the fastest of several timing batches
+double time_render(void (*render)(void)) {
+    double start, elapsed, best = 0;
+    int batch, runs;
+
+    for (batch = 0; batch < BATCHES; batch++) {
+        runs = 0;
+        start = seconds();
+        do {
+            render();
+            runs++;
+            elapsed = seconds() - start;
+        } while (elapsed < BATCH_SECONDS);
+        elapsed = elapsed * 1000.0 / runs;
+        if (batch == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int test_run(char *name, void (*render)(void), int argc, char *argv[]) {
+    char value[LINE_SIZE];
+    ulong crc, golden;
+    double ms, baseline, threshold;
+    int bless, rc = EXIT_SUCCESS;
+    char *env;
+
+    bless = (argc > 1 && strcmp(argv[1], "bless") == 0);
+    env = getenv("PERF_THRESHOLD");
+    threshold = (env != NULL) ? atof(env) : DEFAULT_THRESHOLD;
+
+    render();
+    crc = screen_crc32();
+    sprintf(value, "%08lx", crc);
+
+    if (bless) {
+        file_store(GOLDEN_FILE, name, value);
+        printf("%-10s golden %08lx recorded\n", name, crc);
+    } else if (!file_lookup(GOLDEN_FILE, name, value)) {
+        write_ppm(name);
+        printf("%-10s FAIL   %08lx, no golden (see %s.ppm, \"make bless\" records it)\n",
+            name, crc, name);
+        return EXIT_FAILURE;
+    } else {
+        golden = strtoul(value, NULL, 16);
+        if (crc != golden) {
+            write_ppm(name);
+            printf("%-10s FAIL   %08lx, expected %08lx (see %s.ppm)\n", name, crc, golden, name);
+            return EXIT_FAILURE;
+        }
+        printf("%-10s ok     %08lx\n", name, crc);
+    }
+
+    ms = time_render(render);
+    if (bless || !file_lookup(PERF_FILE, name, value)) {
+        sprintf(value, "%.4f", ms);
+        file_store(PERF_FILE, name, value);
+        printf("%-10s timing %.3f ms recorded\n", name, ms);
+    } else {
+        baseline = atof(value);
+        if (ms > baseline * (1.0 + threshold / 100.0)) {
+            printf("%-10s FAIL   %.3f ms, baseline %.3f ms (%+.1f%%, limit %.0f%%)\n",
+                name, ms, baseline, (ms / baseline - 1.0) * 100.0, threshold);
+            rc = EXIT_FAILURE;
+        } else {
+            printf("%-10s ok     %.3f ms, baseline %.3f ms (%+.1f%%)\n",
+                name, ms, baseline, (ms / baseline - 1.0) * 100.0);
+        }
+    }
+
+    return rc;
+}
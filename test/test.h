@@ -0,0 +1,17 @@
+/**
+ * Test
+ *
+ * Golden image and performance checks for the graphics programs, run on the
+ * host against the off-screen buffer in common/vga.c.
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+extern int test_key_polls;              // kbhit() returns false this many times
+
+// render once and check the screen and palette against the golden checksum,
+// then time repeated renders against the baseline; returns an exit status
+int test_run(char *name, void (*render)(void), int argc, char *argv[]);
+
+#endif